@@ -0,0 +1,92 @@
+#include "detfm/opinfo.hpp"
+#include <abc/parser/Instruction.hpp>
+#include <abc/parser/Parser.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+#include <random>
+
+using namespace athes::detfm;
+
+// Instructions per method and methods measured
+constexpr uint32_t count = 20000;
+constexpr int rounds     = 50;
+
+constexpr uint8_t pushbyte = 0x24, iftrue = 0x11, lookupswitch = 0x1b;
+
+static void write_s24(std::vector<uint8_t>& code, int32_t value) {
+    for (int i = 0; i < 3; ++i)
+        code.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+/* A method where one instruction in 4 jumps forward and one in 32 is a switch whose cases share
+ * targets, like the obfuscated code before its simplification */
+static void synthesize(abc::Method& method) {
+    std::mt19937 rng(42);
+    std::vector<uint8_t> kinds(count, pushbyte);
+    std::vector<uint32_t> addrs(count + 1, 0);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (i % 32 == 0)
+            kinds[i] = lookupswitch;
+        else if (i % 4 == 0)
+            kinds[i] = iftrue;
+
+        addrs[i + 1] = addrs[i] + (kinds[i] == lookupswitch ? 14 : kinds[i] == iftrue ? 4 : 2);
+    }
+
+    const auto target = [&](uint32_t i) {
+        return addrs[std::min<uint32_t>(count - 1, i + 1 + rng() % 64)];
+    };
+
+    auto& code = method.code;
+    code.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto addr = static_cast<int32_t>(addrs[i]);
+        code.push_back(kinds[i]);
+        if (kinds[i] == pushbyte) {
+            code.push_back(static_cast<uint8_t>(i));
+        } else if (kinds[i] == iftrue) {
+            write_s24(code, static_cast<int32_t>(target(i)) - addr - 4);
+        } else {
+            // Switch offsets are relative to the switch itself: default, 3 cases
+            const auto shared = static_cast<int32_t>(target(i)) - addr;
+            write_s24(code, shared);
+            code.push_back(2);
+            write_s24(code, shared);
+            write_s24(code, static_cast<int32_t>(target(i)) - addr);
+            write_s24(code, shared);
+        }
+    }
+}
+
+int main() {
+    abc::Method method;
+    synthesize(method);
+
+    double build = 0, removals = 0;
+    for (int round = 0; round < rounds; ++round) {
+        Parser parser(method);
+        const auto start = std::chrono::steady_clock::now();
+        OpRegister reg(parser, method);
+        const auto built = std::chrono::steady_clock::now();
+
+        // Remove every other instruction that isn't a jump, as the simplifications do
+        uint32_t i = 0;
+        for (auto ins = parser.begin; ins && ins->next; ++i) {
+            auto next = ins->next;
+            if (i % 2 == 1 && !ins->isJump())
+                reg[ins]->remove(parser, reg);
+            ins = next;
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        build += std::chrono::duration<double, std::milli>(built - start).count();
+        removals += std::chrono::duration<double, std::milli>(end - built).count();
+    }
+
+    fmt::print(
+        "{} instructions: register {:.3f} ms, removals {:.3f} ms\n",
+        count,
+        build / rounds,
+        removals / rounds);
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "pipeline.hpp"
+#include "utils.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace athes::detfm {
+/* Deobfuscates the files listed in a manifest.
+ * Several files are processed at once, each by its own thread, so one can be downloaded or
+ * unpacked while another uses the pool. The number of files in flight bounds the memory used.
+ * When several files are in flight, only a line per file is logged instead of their progress.
+ */
+class Batch {
+public:
+    struct Entry {
+        std::string input;
+        std::string output;
+    };
+
+    Batch(Pipeline& pipeline, utils::Logger logger);
+
+    /* Read the manifest: one input (a path or an url) and its output per line, separated by a tab
+     * or spaces. Empty lines and lines starting with '#' are ignored.
+     * Return the error message upon failure */
+    std::optional<std::string> read(std::string const& manifest);
+
+    /* Process every file, at most in_flight at once.
+     * Return 0 if they all succeeded, or the exit code of the first failing file otherwise */
+    int run(size_t in_flight);
+
+private:
+    Pipeline& pipeline;
+    utils::Logger logger;
+    std::vector<Entry> entries;
+
+    int process(Pipeline& pipeline, Entry const& entry);
+};
+}
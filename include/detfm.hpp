@@ -1,17 +1,25 @@
 #pragma once
+#include "detfm/Bytecode.hpp"
+#include "detfm/ClassIndex.hpp"
+#include "detfm/CodeCache.hpp"
+#include "detfm/OpcodeFilter.hpp"
+#include "detfm/PacketDatabase.hpp"
+#include "detfm/PoolWriter.hpp"
 #include "detfm/StaticClass.hpp"
+#include "detfm/ThreadPool.hpp"
 #include "detfm/WrapClass.hpp"
 #include "packets.hpp"
 #include "renamer.hpp"
 #include "utils.hpp"
 #include <abc/parser/Parser.hpp>
 #include <abc/parser/opcodes.hpp>
+#include <atomic>
 #include <cstdint>
 #include <memory>
-#include <mutex>
 #include <optional>
 #include <set>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -21,9 +29,14 @@ constexpr const char* version = "0.5.3";
 using swf::abc::parser::Instruction;
 namespace abc = swf::abc;
 
+// How methods are distributed between threads
+enum class Schedule {
+    lpt, // Longest processing time first, based on the bytecode's size
+    chunked, // Contiguous chunks of methods
+};
+
 class detfm {
     using MethodIterator = std::vector<abc::Method>::iterator;
-    using PacketMap      = std::unordered_map<std::string, std::string>;
 
 public:
     uint32_t ByteArray    = 0;
@@ -36,26 +49,31 @@ public:
 
     std::unique_ptr<WrapClass> wrap_class;
     StaticClasses static_classes;
+    PacketTables packets;
 
-    detfm(std::shared_ptr<abc::AbcFile>& abc, Fmt fmt, utils::Logger logger);
+    detfm(std::shared_ptr<abc::AbcFile>& abc, Fmt fmt, utils::Logger logger, ThreadPool& pool);
 
     /* Find classes needed to unscrumble the code */
     std::vector<std::string> analyze();
     /* Simplify expressions inside the classes' init method */
     void simplify_init();
     /* Unscramble bytecode by removing useless wrapper methods and resolving static slots */
-    void unscramble();
-    void unscramble(MethodIterator first, MethodIterator last);
-    void unscramble(abc::Method& method);
+    WorkBalance unscramble(Schedule schedule = Schedule::lpt);
+    void unscramble(MethodIterator first, MethodIterator last, PoolWriter& writer);
+    /* Return false when new constants were staged: unscramble it again once they are committed */
+    bool unscramble(abc::Method& method, PoolWriter& writer);
+    /* Methods the last unscramble() skipped, as they had nothing to unscramble */
+    size_t skipped_methods() const;
     /* Rename Classes to make it easier to read */
     void rename();
+    /* Classes emptied by rename(): nothing refers to them once unscrambled */
+    std::vector<uint32_t> dead_classes();
 
     /* Change the server's ip to localhost */
     std::optional<std::string> proxy2localhost(std::string port = "11801");
 
-    /* Find a packet's name from its code */
-    std::string get_known_name(PacketMap const& lookup, std::string code);
-    std::string get_known_name(PacketMap const& lookup, uint16_t code);
+    /* Find a packet's name from its code, empty if it's unknown */
+    std::string_view get_known_name(pktnames::Table const& lookup, uint16_t code);
 
 private:
     bool match_serverbound_pkt(abc::Class& klass);
@@ -80,18 +98,17 @@ private:
     void find_clientbound_packets();
     void find_clientbound_packets(abc::Class& klass, uint32_t& trait_name, uint8_t& category);
 
-    bool find_clientbound_tribulle(std::shared_ptr<Instruction> ins);
+    bool find_clientbound_tribulle(Bytecode const& bytecode, uint32_t ins);
     void find_serverbound_tribulle(abc::Class& klass);
 
-    std::optional<abc::Class> find_class_by_name(uint32_t& name);
-    std::optional<abc::Trait>
-    find_ctrait_by_name(abc::Class& klass, uint32_t& name, bool check_super = true);
-    std::optional<abc::Trait>
-    find_itrait_by_name(abc::Class& klass, uint32_t& name, bool check_super = true);
-    std::optional<abc::Trait> find_trait(abc::Class& klass, uint32_t& name);
+    /* Lookups through the index built by analyze(), nullptr when nothing is found */
+    abc::Class* find_class_by_name(uint32_t name);
+    abc::Trait* find_ctrait_by_name(abc::Class& klass, uint32_t name, bool check_super = true);
+    abc::Trait* find_itrait_by_name(abc::Class& klass, uint32_t name, bool check_super = true);
+    abc::Trait* find_trait(abc::Class& klass, uint32_t name);
 
-    bool get_packet_code(std::shared_ptr<Instruction>& ins, uint8_t& code);
-    bool is_sequence(std::shared_ptr<Instruction> ins, const std::vector<OP>& ops);
+    /* Read the packet code compared at ins; ins is moved to the comparison's jump on success */
+    bool get_packet_code(Bytecode const& bytecode, uint32_t& ins, uint8_t& code);
 
     void set_class_ns(abc::Class& klass, uint32_t& ns);
     uint32_t create_package(std::string name);
@@ -100,7 +117,11 @@ private:
     utils::Logger logger;
     Fmt fmt;
     std::shared_ptr<abc::AbcFile> abc;
-    std::mutex add_value_mut;
+    ThreadPool& pool;
+    CodeCache code_cache; // valid until the methods are rewritten outside of detfm
+    ClassIndex classes;
+    std::optional<OpcodeFilter> unscramble_filter;
+    std::atomic<size_t> skipped = 0;
     struct {
         uint32_t pkt; // packets
         uint32_t spkt; // packets.serverbound
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace athes::detfm {
+/* Per-thread monotonic memory for the temporaries of a method's rewrite.
+ * Allocations are never freed one by one: everything is released at once when the Scope ends, so
+ * scopes must not nest. A rewrite runs no other work on its thread, so none ever does. The buffer
+ * is kept between methods and grown when a method needed more, so once warmed up a thread stops
+ * calling the global allocator.
+ */
+class Arena {
+public:
+    // Use the thread's arena until the end of the scope
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(Scope const&)            = delete;
+        Scope& operator=(Scope const&) = delete;
+
+        std::pmr::memory_resource* resource() const;
+
+    private:
+        Arena& arena;
+    };
+
+    Arena(size_t capacity = 64 * 1024);
+
+    /* Arena of the calling thread */
+    static Arena& local();
+
+private:
+    // Counts what didn't fit in the buffer
+    class Overflow : public std::pmr::memory_resource {
+    public:
+        size_t allocated = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+        bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+    };
+
+    std::unique_ptr<std::byte[]> buffer;
+    size_t capacity;
+    Overflow overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> memory;
+
+    void reset();
+};
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <abc/AbcFile.hpp>
+#include <abc/parser/opcodes.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace athes::detfm {
+namespace abc = swf::abc;
+using swf::abc::parser::OP;
+
+/* Flat copy of a method's instructions, decoded once.
+ * Instructions are referred to by their position, from 0 to size() (the end). Their opcodes,
+ * addresses, operands and jump targets are stored in separate arrays, so scanning the code is a
+ * linear walk instead of following the parser's linked list.
+ * It is read-only: passes rewriting the code still go through the Parser.
+ */
+class Bytecode {
+public:
+    Bytecode() = default;
+    Bytecode(abc::Method& method);
+
+    uint32_t size() const { return static_cast<uint32_t>(opcodes.size()); }
+    bool empty() const { return opcodes.empty(); }
+
+    OP op(uint32_t pos) const { return opcodes[pos]; }
+    /* Whether there's an instruction at the given position with the given opcode */
+    bool is(uint32_t pos, OP opcode) const { return pos < size() && opcodes[pos] == opcode; }
+    uint32_t addr(uint32_t pos) const { return addrs[pos]; }
+
+    size_t nargs(uint32_t pos) const { return arg_offsets[pos + 1] - arg_offsets[pos]; }
+    uint32_t arg(uint32_t pos, size_t n = 0) const { return args[arg_offsets[pos] + n]; }
+
+    /* Position of the instruction targeted by the nth jump of the instruction */
+    size_t ntargets(uint32_t pos) const { return target_offsets[pos + 1] - target_offsets[pos]; }
+    uint32_t target(uint32_t pos, size_t n = 0) const { return targets[target_offsets[pos] + n]; }
+
+    /* Position of the first instruction with the given opcode from pos, or size() */
+    uint32_t find(OP opcode, uint32_t pos = 0) const;
+    /* Whether the instructions starting at pos have the given opcodes */
+    bool matches(uint32_t pos, std::vector<OP> const& sequence) const;
+
+private:
+    std::vector<OP> opcodes;
+    std::vector<uint32_t> addrs;
+    std::vector<uint32_t> arg_offsets;
+    std::vector<uint32_t> args;
+    std::vector<uint32_t> target_offsets;
+    std::vector<uint32_t> targets;
+};
+}
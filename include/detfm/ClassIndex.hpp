@@ -0,0 +1,47 @@
+#pragma once
+#include <abc/AbcFile.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace athes::detfm {
+namespace abc = swf::abc;
+
+/* Classes by name, and their traits by name along the prototype chain.
+ * The classes are indexed on build(), their traits and chain the first time they are looked up:
+ * the classes must not move, nor a looked up class' traits change, until the next build().
+ */
+class ClassIndex {
+public:
+    void build(abc::AbcFile& abc);
+
+    /* Class with the given name, nullptr if there is none */
+    abc::Class* find(uint32_t name) const;
+
+    /* The class followed by its super classes, as far as they are known */
+    std::vector<abc::Class*> const& chain(abc::Class& klass);
+
+    /* Trait with the given name, from the class or its super classes. nullptr if there is none */
+    abc::Trait* ctrait(abc::Class& klass, uint32_t name, bool check_super = true);
+    abc::Trait* itrait(abc::Class& klass, uint32_t name, bool check_super = true);
+
+private:
+    using Traits = std::unordered_map<uint32_t, abc::Trait*>;
+    struct Entry {
+        bool indexed  = false;
+        bool chained  = false;
+        bool visiting = false;
+        Traits ctraits;
+        Traits itraits;
+        std::vector<abc::Class*> chain;
+    };
+
+    abc::Class* first = nullptr;
+    std::vector<abc::Class*> by_name; // by multiname
+    std::vector<Entry> entries; // by class
+
+    Entry& entry(abc::Class& klass);
+    Entry& indexed(abc::Class& klass);
+    abc::Trait* lookup(abc::Class& klass, uint32_t name, bool check_super, Traits Entry::*traits);
+};
+}
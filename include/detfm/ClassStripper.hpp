@@ -0,0 +1,50 @@
+#pragma once
+#include "detfm/ThreadPool.hpp"
+#include <abc/AbcFile.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace athes::detfm {
+namespace abc = swf::abc;
+
+/* Removes classes nothing refers to anymore, along with their methods and the scripts defining
+ * them. Class and method indices are remapped everywhere, so pointers and indices kept elsewhere
+ * are invalidated.
+ */
+class ClassStripper {
+public:
+    struct Stats {
+        size_t classes = 0;
+        size_t methods = 0;
+        size_t scripts = 0;
+        std::vector<std::string> names; // qualified names of the removed classes ("pkg.Name")
+    };
+
+    ClassStripper(std::shared_ptr<abc::AbcFile> const& abc, ThreadPool& pool);
+
+    /* Remove the given classes. Classes that are still referenced, or whose script defines
+     * anything else, are kept. */
+    Stats strip(std::vector<uint32_t> const& candidates);
+
+private:
+    std::shared_ptr<abc::AbcFile> abc;
+    ThreadPool& pool;
+
+    /* The name symbols give the class: its package, if any, then its name */
+    std::string qualified_name(abc::Class& klass) const;
+    std::vector<uint8_t> dead_scripts(std::vector<uint8_t>& classes) const;
+    /* Class owning each dead method, 0 for the live ones */
+    std::vector<uint32_t>
+    dead_methods(std::vector<uint8_t> const& classes, std::vector<uint8_t> const& scripts) const;
+    /* Keep the classes still referenced by live code. Return whether any class was kept. */
+    bool keep_referenced(
+        std::vector<uint8_t>& classes, std::vector<uint32_t> const& owners,
+        std::vector<uint8_t>& has_refs);
+    void remove(
+        std::vector<uint8_t> const& classes, std::vector<uint32_t> const& owners,
+        std::vector<uint8_t> const& scripts, std::vector<uint8_t>& has_refs);
+};
+}
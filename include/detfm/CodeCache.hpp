@@ -0,0 +1,33 @@
+#pragma once
+#include "detfm/Bytecode.hpp"
+#include <abc/AbcFile.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace athes::detfm {
+namespace abc = swf::abc;
+
+/* Decoded methods, by index, so each method is parsed once across the passes.
+ * A method is decoded on first use and kept until invalidated: whoever rewrites method.code must
+ * call invalidate(). Different methods may be used from different threads at once.
+ * The methods are sized once, adding or removing methods requires a new cache.
+ */
+class CodeCache {
+public:
+    CodeCache(std::shared_ptr<abc::AbcFile> const& abc);
+
+    Bytecode const& get(uint32_t method);
+    Bytecode const& get(abc::Method& method);
+
+    /* Forget the decoded code, the method has been rewritten */
+    void invalidate(uint32_t method);
+    void invalidate(abc::Method& method);
+
+private:
+    std::shared_ptr<abc::AbcFile> abc;
+    std::vector<std::unique_ptr<Bytecode>> methods;
+
+    uint32_t index_of(abc::Method& method) const;
+};
+}
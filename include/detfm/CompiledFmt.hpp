@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace athes::detfm {
+/* A format string parsed once into literal text and replacement fields.
+ * Integers with a fill, width and base (e.g. {:03d}, {:0>4x}) and strings without any spec are
+ * written directly. Any other field is formatted by fmt, on its own.
+ * Invalid format strings are not detected here: they must be checked beforehand.
+ */
+class CompiledFmt {
+public:
+    CompiledFmt() = default;
+    explicit CompiledFmt(std::string_view format);
+
+    /* Append the formatted arguments to out */
+    template <typename... Types> void format_to(std::string& out, Types const&... args) const {
+        for (auto& segment : segments) {
+            if (segment.arg < 0) {
+                out += segment.text;
+                continue;
+            }
+
+            size_t index = 0;
+            ((index++ == static_cast<size_t>(segment.arg) ? write(out, segment, args) : void()),
+             ...);
+        }
+    }
+    template <typename... Types> std::string format(Types const&... args) const {
+        std::string out;
+        format_to(out, args...);
+        return out;
+    }
+
+private:
+    struct Segment {
+        int arg = -1; // the argument's index, -1 for literal text
+        std::string text; // the literal text, or the field as given to fmt ("{:...}")
+        bool plain   = false; // no spec at all
+        bool direct  = false; // whether an integer is written without fmt
+        char fill    = ' ';
+        bool zeros   = false; // zero padding, after the sign
+        size_t width = 0;
+        int base     = 10;
+        bool upper   = false;
+    };
+    std::vector<Segment> segments;
+
+    static void parse_spec(Segment& segment, std::string_view spec);
+    static void
+    write_integer(std::string& out, Segment const& segment, bool negative, uint64_t value);
+
+    template <typename T>
+    static void write(std::string& out, Segment const& segment, T const& arg) {
+        if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, char>) {
+            // formatted as text by fmt
+        } else if constexpr (std::is_integral_v<T>) {
+            if (segment.direct) {
+                bool negative = false;
+                if constexpr (std::is_signed_v<T>)
+                    negative = arg < 0;
+
+                const auto value = static_cast<uint64_t>(arg);
+                return write_integer(out, segment, negative, negative ? 0 - value : value);
+            }
+        } else if constexpr (std::is_convertible_v<T const&, std::string_view>) {
+            if (segment.plain)
+                return void(out += std::string_view(arg));
+        }
+        out += fmt::vformat(segment.text, fmt::make_format_args(arg));
+    }
+};
+}
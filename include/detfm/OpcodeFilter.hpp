@@ -0,0 +1,34 @@
+#pragma once
+#include <abc/parser/opcodes.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace athes::detfm {
+using swf::abc::parser::OP;
+
+/* Byte-level pre-scan of a method's code, looking for some opcodes with some first operands.
+ * Every byte equal to one of the opcodes is decoded as an instruction: operand bytes may give
+ * false positives, but a real instruction is never missed. Up to 8 opcodes can be watched.
+ */
+class OpcodeFilter {
+public:
+    static constexpr size_t max_opcodes = 8;
+
+    /* Operands are below the given bound (e.g. the number of multinames) */
+    OpcodeFilter(uint32_t operands);
+
+    void add(OP opcode, uint32_t operand);
+
+    /* Whether the code may contain one of the instructions */
+    bool matches(std::vector<uint8_t> const& code) const;
+
+private:
+    std::vector<uint8_t> opcodes; // watched opcodes, by slot
+    std::array<uint8_t, 256> slots {}; // bit of each watched opcode's slot
+    std::vector<uint8_t> operands; // bits of the slots watching each operand
+
+    bool matches_at(std::vector<uint8_t> const& code, size_t pos) const;
+};
+}
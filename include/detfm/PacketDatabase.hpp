@@ -0,0 +1,49 @@
+#pragma once
+#include "packets.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace athes::detfm {
+/* Packet names used to rename the packets, the compiled-in ones by default */
+struct PacketTables {
+    pktnames::Table clientbound          = pktnames::clientbound;
+    pktnames::Table serverbound          = pktnames::serverbound;
+    pktnames::Table tribulle_clientbound = pktnames::tribulle_clientbound;
+    pktnames::Table tribulle_serverbound = pktnames::tribulle_serverbound;
+};
+
+/* Packet names read from a file written by `compile_packets.py --binary`.
+ * The file is mapped in memory and the names point into it, so the tables are only valid as long
+ * as the database lives.
+ */
+class PacketDatabase {
+public:
+    PacketDatabase() = default;
+    ~PacketDatabase();
+
+    PacketDatabase(PacketDatabase const&)            = delete;
+    PacketDatabase& operator=(PacketDatabase const&) = delete;
+
+    /* Map the file and check its tables, whose names must all be known.
+     * Return the error message upon failure */
+    std::optional<std::string> load(std::string const& path);
+
+    /* The loaded tables, the compiled-in ones for the tables missing from the file */
+    PacketTables tables() const;
+
+private:
+    struct Loaded {
+        std::string name;
+        std::vector<pktnames::Packet> packets;
+    };
+
+    uint8_t const* data = nullptr;
+    size_t size         = 0;
+    std::vector<Loaded> loaded;
+
+    void unmap();
+};
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "detfm/ThreadPool.hpp"
+#include <abc/AbcFile.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace athes::detfm {
+namespace abc = swf::abc;
+
+/* Removes the duplicated and unreferenced values of the constant pool (integers, unsigned
+ * integers, doubles and strings), then remaps every index pointing to them: instructions' operands,
+ * slots' values, multinames, namespaces, methods and metadata.
+ * Multinames and namespaces themselves are neither removed nor remapped, so every string they name
+ * is kept: the names of the traits cleared by detfm::rename() and of stripped classes stay.
+ * The values are kept in their original order, so the output only depends on the input.
+ * It invalidates every index kept elsewhere, so it must run right before writing the file.
+ */
+class PoolCompactor {
+public:
+    struct Stats {
+        size_t integers  = 0;
+        size_t uintegers = 0;
+        size_t doubles   = 0;
+        size_t strings   = 0;
+
+        size_t total() const { return integers + uintegers + doubles + strings; }
+    };
+
+    PoolCompactor(std::shared_ptr<abc::AbcFile> const& abc, ThreadPool& pool);
+
+    /* Compact the pools and return how many values were removed */
+    Stats compact();
+
+private:
+    template <typename T> struct PerPool {
+        std::vector<T> integers, uintegers, doubles, strings;
+    };
+    using Marks  = PerPool<uint8_t>;  // whether each value is used
+    using Remaps = PerPool<uint32_t>; // old index to new index
+
+    std::shared_ptr<abc::AbcFile> abc;
+    ThreadPool& pool;
+
+    Marks marks() const;
+    void mark_code(Marks& marks, std::vector<uint8_t>& has_refs);
+    void mark_constants(Marks& marks);
+    void remap_constants(Remaps const& remaps);
+    void remap_code(Remaps const& remaps, std::vector<uint8_t> const& has_refs);
+};
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <abc/AbcFile.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace athes::detfm {
+namespace abc = swf::abc;
+
+/* Adds values to the constant pool from several threads at once, without locking.
+ * Values already in the pool are reused. New values are staged in a per-thread buffer and the
+ * method needing them has to be rewritten once they are committed: their indices, and so the size
+ * of the instructions using them, are only known then.
+ * Staged values are committed in method order, so the pool's layout does not depend on how the
+ * methods were distributed between threads.
+ */
+class PoolWriter {
+public:
+    PoolWriter(std::shared_ptr<abc::AbcFile> const& abc, size_t workers = 1);
+
+    /* Get the value's index, or stage it for the given method */
+    std::optional<uint32_t> add_integer(int32_t value, uint32_t method);
+    std::optional<uint32_t> add_double(double value, uint32_t method);
+    std::optional<uint32_t> add_string(std::string const& value, uint32_t method);
+
+    /* Append the staged values to the constant pool.
+     * Return the methods that staged values, in ascending order: they need to be rewritten. */
+    std::vector<uint32_t> commit();
+
+private:
+    template <typename T> using Staged = std::vector<std::pair<uint32_t, T>>;
+    struct Buffer {
+        Staged<int32_t> integers;
+        Staged<double> doubles;
+        Staged<std::string> strings;
+    };
+
+    std::shared_ptr<abc::AbcFile> abc;
+    std::vector<Buffer> buffers;
+
+    // Indices of the values in the pool, built on first use
+    std::unordered_map<int32_t, uint32_t> integers;
+    std::unordered_map<uint64_t, uint32_t> doubles; // by bit pattern, to tell -0.0 and NaNs apart
+    std::unordered_map<std::string, uint32_t> strings;
+    std::once_flag integers_once, doubles_once, strings_once;
+
+    Buffer& buffer();
+    void index_integers();
+    void index_doubles();
+    void index_strings();
+};
+}
@@ -4,31 +4,51 @@
 #include <cstdint>
 #include <memory>
 #include <unordered_map>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace athes::detfm {
+class CodeCache;
+
 using namespace swf::abc::parser;
 namespace abc = swf::abc;
 
 class StaticClass {
 public:
+    using Value = std::variant<int32_t, double>;
+
     abc::Class* klass;
-    std::unordered_map<uint32_t, abc::Trait*> slots;
-    std::unordered_map<uint32_t, std::variant<int32_t, double>> methods;
+    // Sorted by trait name
+    std::vector<std::pair<uint32_t, abc::Trait*>> slots;
+    std::vector<std::pair<uint32_t, Value>> methods;
 
     StaticClass();
-    StaticClass(std::shared_ptr<abc::AbcFile>& abc, abc::Class& klass);
-    bool is_slot(uint32_t index);
-    bool is_slot(std::shared_ptr<Instruction>& ins);
-    bool is_method(uint32_t index);
-    bool is_method(std::shared_ptr<Instruction>& ins);
+    StaticClass(std::shared_ptr<abc::AbcFile>& abc, abc::Class& klass, CodeCache& code);
+
+    /* The slot or the method's value with the given name, nullptr if there is none */
+    abc::Trait* slot(uint32_t name) const;
+    Value const* method(uint32_t name) const;
+
+    bool is_slot(uint32_t index) const;
+    bool is_slot(std::shared_ptr<Instruction>& ins) const;
+    bool is_method(uint32_t index) const;
+    bool is_method(std::shared_ptr<Instruction>& ins) const;
 };
 
 class StaticClasses {
 public:
     std::unordered_map<uint32_t, StaticClass> classes;
 
+    /* Build the lookup table once every class is added, names are below the given bound */
+    void index(size_t multinames);
+
     StaticClass& operator[](uint32_t index);
-    bool is_static_class(uint32_t klass);
+    /* The static class with the given name, nullptr if there is none */
+    StaticClass* find(uint32_t klass) const;
+    bool is_static_class(uint32_t klass) const;
+
+private:
+    std::vector<StaticClass*> lookup; // by name
 };
-}
\ No newline at end of file
+}
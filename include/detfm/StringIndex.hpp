@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace athes::detfm {
+/* Indices of the constant pool's strings, by value.
+ * The keys point into the pool: strings must only be changed through replace(), and none added
+ * while the index is used.
+ */
+class StringIndex {
+public:
+    StringIndex(std::vector<std::string>& strings);
+
+    /* Indices of the strings equal to the value, empty if there is none */
+    std::vector<uint32_t> const& find(std::string_view value) const;
+
+    /* Replace every string equal to from by to. Return the number of strings replaced */
+    size_t replace(std::string_view from, std::string const& to);
+
+private:
+    std::vector<std::string>& strings;
+    std::unordered_map<std::string_view, std::vector<uint32_t>> indices;
+};
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "detfm/WorkQueue.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace athes::detfm {
+/* Pool of threads shared by every parallel phase.
+ * The calling thread takes part in the work of the loops it submits, so a pool of size 1 has no
+ * extra thread and runs everything sequentially. Loops can be submitted from several threads at
+ * once, or from inside another loop.
+ */
+class ThreadPool {
+public:
+    using RangeTask = std::function<void(WorkRange range)>;
+    using IndexTask = std::function<void(size_t index)>;
+
+    ThreadPool(uint32_t jobs);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&)            = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    /* Number of threads working on a loop, including the calling thread */
+    size_t size() const;
+    /* Index of the current thread in [0, size()), 0 for threads outside of the pool.
+     * Lets loop tasks use per-thread data without locking. */
+    static size_t worker();
+
+    /* Run the task on chunks of [0, count) and wait for its completion.
+     * The first exception thrown by the task is rethrown here. */
+    WorkBalance parallel_for(size_t count, RangeTask const& task, size_t grain = 0);
+    /* Run the task on each index of [0, costs.size()), the most costly first */
+    WorkBalance parallel_for(std::vector<uint64_t> const& costs, IndexTask const& task);
+
+private:
+    struct Job {
+        WorkQueue queue;
+        std::function<uint64_t(WorkRange range)> run;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed = false;
+        std::exception_ptr error;
+        std::mutex mut;
+        std::condition_variable done;
+
+        Job(size_t workers) : queue(workers) { }
+    };
+
+    std::vector<std::thread> threads;
+    std::list<std::shared_ptr<Job>> jobs;
+    std::mutex mut;
+    std::condition_variable available;
+    bool stopping = false;
+
+    WorkBalance submit(std::shared_ptr<Job> job, size_t count);
+    void work(size_t worker);
+    void help(Job& job, size_t worker);
+    void retire(std::shared_ptr<Job> const& job);
+};
+}
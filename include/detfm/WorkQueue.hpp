@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace athes::detfm {
+// Half-open range of indices: [first, last)
+struct WorkRange {
+    size_t first;
+    size_t last;
+};
+
+// How evenly the work was spread across the workers
+struct WorkBalance {
+    size_t workers   = 0;
+    uint64_t total   = 0; // Total cost processed
+    uint64_t busiest = 0; // Cost processed by the busiest worker
+
+    /* Ratio between the ideal wall time (total / workers) and the achieved one (busiest) */
+    double efficiency() const;
+};
+
+/* Work-stealing queue of index ranges.
+ * Each worker owns a deque: it takes work from the front of its own deque, and steals from the
+ * back of the others' once it runs dry. Locks are per worker, so they are only contended when a
+ * worker is being stolen from.
+ */
+class WorkQueue {
+public:
+    WorkQueue(size_t workers);
+
+    size_t workers() const;
+
+    /* Split [0, count) into chunks of `grain` indices, each worker getting a contiguous block.
+     * A grain of 0 picks one small enough for stealing to even out the load. */
+    void split(size_t count, size_t grain = 0);
+    /* Longest-processing-time-first scheduling: deal the indices [0, costs.size()) one by one,
+     * from the most to the least costly, to the least loaded worker.
+     * Ranges then refer to positions in that order, use index() to get the actual index. */
+    void schedule(std::vector<uint64_t> const& costs);
+    void push(size_t worker, WorkRange range);
+    /* Get the next range to process for the given worker, stealing it if needed */
+    bool pop(size_t worker, WorkRange& range);
+
+    /* Whether ranges map directly to indices (i.e. schedule() was not used) */
+    bool is_identity() const;
+    /* Get the index at the given position of a range */
+    size_t index(size_t position) const;
+
+    /* Account the cost of the work done by the given worker. Must be called by that worker. */
+    void done(size_t worker, uint64_t cost);
+    WorkBalance balance() const;
+
+private:
+    struct Slot {
+        std::mutex mut;
+        std::deque<WorkRange> ranges;
+        uint64_t load = 0;
+    };
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<size_t> order;
+
+    bool steal(size_t worker, WorkRange& range);
+};
+}
@@ -3,7 +3,7 @@
 #include <abc/parser/Parser.hpp>
 #include <cstdint>
 #include <memory>
-#include <set>
+#include <vector>
 
 namespace athes::detfm {
 using swf::abc::parser::Instruction;
@@ -12,15 +12,19 @@ namespace abc = swf::abc;
 class WrapClass {
 public:
     abc::Class* klass;
-    std::set<uint32_t> methods;
+    std::vector<uint32_t> methods;
 
-    WrapClass(abc::Class& klass);
+    /* Method names are below the given bound */
+    WrapClass(abc::Class& klass, size_t multinames);
 
     bool operator==(uint32_t& name);
     uint32_t name();
 
-    bool is_wrap(uint32_t method);
-    bool is_wrap(std::shared_ptr<Instruction>& ins);
+    bool is_wrap(uint32_t method) const;
+    bool is_wrap(std::shared_ptr<Instruction>& ins) const;
+
+private:
+    std::vector<uint8_t> wraps; // by name
 };
 bool operator==(uint32_t& name, std::unique_ptr<WrapClass>& klass);
 }
\ No newline at end of file
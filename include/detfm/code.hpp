@@ -0,0 +1,26 @@
+#pragma once
+#include <abc/AbcFile.hpp>
+#include <abc/parser/Parser.hpp>
+
+namespace athes::detfm {
+/* Write the instructions back to the method.
+ * The instructions are laid out again, moving the jumps' and exceptions' addresses, so operands can
+ * be changed freely beforehand. */
+void write_code(swf::abc::Method& method, swf::abc::parser::Parser& parser);
+
+/* Call fn on every trait: classes', scripts' and methods' (activation) ones */
+template <typename Fn> void for_each_trait(swf::abc::AbcFile& abc, Fn fn) {
+    for (auto& klass : abc.classes) {
+        for (auto& trait : klass.itraits)
+            fn(trait);
+        for (auto& trait : klass.ctraits)
+            fn(trait);
+    }
+    for (auto& script : abc.scripts)
+        for (auto& trait : script.traits)
+            fn(trait);
+    for (auto& method : abc.methods)
+        for (auto& trait : method.traits)
+            fn(trait);
+}
+}
@@ -6,6 +6,8 @@ class Method;
 }
 
 namespace athes::detfm {
+class Bytecode;
+
 template <typename T>
-T eval_method(std::shared_ptr<swf::abc::AbcFile>& abc, swf::abc::Method& method);
+T eval_method(std::shared_ptr<swf::abc::AbcFile>& abc, Bytecode const& code);
 }
\ No newline at end of file
@@ -2,8 +2,7 @@
 #include <abc/parser/Parser.hpp>
 #include <cstdint>
 #include <memory>
-#include <set>
-#include <unordered_map>
+#include <memory_resource>
 #include <utility>
 #include <vector>
 
@@ -15,19 +14,24 @@ enum class ErrorField { from, to, target };
 
 class ErrorInfo;
 class OpInfo;
+class OpRegister;
 
-using OpRegister = typename std::unordered_map<uint32_t, std::shared_ptr<OpInfo>>;
+/* A list of nodes linked by index through one of the register's vectors, 0 ending it */
+struct EdgeList {
+    uint32_t head = 0;
+    uint32_t tail = 0;
+};
 
-class OpInfo : std::enable_shared_from_this<OpInfo> {
+class OpInfo {
 public:
     uint32_t addr;
     std::shared_ptr<Instruction> ins;
-    std::shared_ptr<OpInfo> next;
-    std::vector<std::shared_ptr<OpInfo>> jumpsTo;
-    std::set<OpInfo*> jumpsHere;
-    std::set<std::pair<ErrorField, ErrorInfo*>> errors;
+    OpInfo* next = nullptr;
+    std::pmr::vector<OpInfo*> jumpsTo; // nullptr for the end of the code
+    EdgeList jumpsHere; // one entry per jump, a switch may jump here several times
+    EdgeList errors;
 
-    OpInfo(std::shared_ptr<Instruction> ins);
+    OpInfo(std::shared_ptr<Instruction> ins, std::pmr::memory_resource* memory);
 
     void remove(Parser& parser, OpRegister& reg);
     bool removed();
@@ -37,11 +41,62 @@ class ErrorInfo {
 public:
     abc::Exception err;
 
-    std::shared_ptr<OpInfo> from   = nullptr;
-    std::shared_ptr<OpInfo> to     = nullptr;
-    std::shared_ptr<OpInfo> target = nullptr;
+    OpInfo* from   = nullptr;
+    OpInfo* to     = nullptr;
+    OpInfo* target = nullptr;
     ErrorInfo(abc::Exception& err, OpRegister& reg);
 
-    void replace(std::shared_ptr<OpInfo>& opinfo, const ErrorField& field);
+    void replace(OpInfo* opinfo, const ErrorField& field);
+};
+
+/* Instructions of a method with their jumps and exceptions resolved.
+ * The OpInfo are stored contiguously, in order, and found by address through a flat table.
+ * They never move, so pointers to them stay valid as long as the register lives.
+ * The incoming jumps and exceptions of every instruction are linked through two shared vectors:
+ * removing an instruction hands them over to the next one without copying or allocating.
+ */
+class OpRegister {
+public:
+    OpRegister(
+        Parser& parser, abc::Method& method,
+        std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    OpRegister(OpRegister const&)            = delete;
+    OpRegister& operator=(OpRegister const&) = delete;
+
+    /* The instruction starting at the given (original) address, nullptr if there is none */
+    OpInfo* at(uint32_t addr);
+    OpInfo* operator[](std::shared_ptr<Instruction> const& ins) { return at(ins->addr); }
+
+    /* Lay the remaining instructions out again and write them back to the method */
+    void write(abc::Method& method);
+
+private:
+    friend class OpInfo;
+    friend class ErrorInfo;
+
+    struct Jump {
+        OpInfo* from;
+        uint32_t arg; // index in from->jumpsTo
+        uint32_t next;
+    };
+    struct ErrorRef {
+        ErrorField field;
+        ErrorInfo* err;
+        uint32_t next;
+    };
+
+    Parser& parser;
+    uint32_t code_size;
+    std::pmr::vector<OpInfo> ops;
+    std::pmr::vector<uint32_t> ordinals; // by address, 0 when no instruction starts there
+    std::pmr::vector<ErrorInfo> exceptions;
+    std::pmr::vector<Jump> jumps;
+    std::pmr::vector<ErrorRef> error_refs;
+
+    template <typename Node>
+    static void append(std::pmr::vector<Node>& nodes, EdgeList& list, Node node);
+    template <typename Node>
+    static void splice(std::pmr::vector<Node>& nodes, EdgeList& into, EdgeList& list);
 };
 }
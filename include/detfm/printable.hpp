@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace athes::detfm {
+/* Whether every character is printable ASCII, like std::isprint in the "C" locale */
+bool is_printable(std::string_view value);
+
+/* Flag the strings having a non printable character, by index */
+std::vector<uint8_t> unprintable_strings(std::vector<std::string> const& strings);
+}
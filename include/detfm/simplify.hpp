@@ -6,5 +6,11 @@ class Method;
 }
 
 namespace athes::detfm {
-void simplify_expressions(std::shared_ptr<swf::abc::AbcFile>& abc, swf::abc::Method& method);
+class PoolWriter;
+
+/* Fold constant expressions.
+ * Return false when new constants were staged in the writer: the method must be simplified again
+ * once they are committed. */
+bool simplify_expressions(
+    std::shared_ptr<swf::abc::AbcFile>& abc, swf::abc::Method& method, PoolWriter& writer);
 }
\ No newline at end of file
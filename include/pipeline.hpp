@@ -0,0 +1,68 @@
+#pragma once
+#include "detfm.hpp"
+#include "detfm/ThreadPool.hpp"
+#include "renamer.hpp"
+#include "utils.hpp"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <swf/swf.hpp>
+#include <vector>
+
+namespace athes::unpack {
+class Unpacker;
+}
+
+namespace athes::detfm {
+struct Options {
+    bool unpack         = true;
+    bool compact        = true;
+    bool strip_classes  = false;
+    bool ignore_missing = false;
+    bool enable_proxy   = false;
+    std::string proxy_port  = "11801";
+    std::string compression = "none";
+    std::optional<std::string> classdef;
+    Schedule schedule = Schedule::lpt;
+    PacketTables packets;
+};
+
+// Runs the whole deobfuscation process on a movie
+class Pipeline {
+public:
+    Pipeline(Options options, Fmt fmt, ThreadPool& pool, utils::Logger logger);
+
+    /* A pipeline using other options, sharing the pool and the loaded class definitions */
+    Pipeline with(Options options) const;
+    /* A pipeline logging with another logger, sharing everything else */
+    Pipeline with(utils::Logger logger) const;
+
+    /* Read the movie from a path, an url or stdin ("-"), and unpack it.
+     * Return 0 upon success, or the exit code otherwise. */
+    int load(std::string const& input, swf::Swf& movie, utils::TimePoints& tps);
+    /* Unpack the movie from the bytes of the file, which must outlive the movie's parsing */
+    int load(std::vector<uint8_t>& buffer, swf::Swf& movie, utils::TimePoints& tps);
+    /* Deobfuscate the movie. Return 0 upon success, or the exit code otherwise. */
+    int run(swf::Swf& movie, utils::TimePoints& tps);
+    /* Serialize the movie, using the compression set in the options */
+    void write(swf::Swf& movie, swf::StreamWriter& writer);
+
+    /* Deobfuscate the movie sequentially, then using the thread pool, and make sure both outputs
+     * are identical. The output of the latter is written to the writer. */
+    int check_determinism(swf::Swf& movie, swf::StreamWriter& writer, utils::TimePoints& tps);
+
+private:
+    struct ClassDefs;
+
+    Options options;
+    Fmt fmt;
+    ThreadPool& pool;
+    utils::Logger logger;
+    std::shared_ptr<ClassDefs> classdefs;
+
+    int parse(
+        std::unique_ptr<unpack::Unpacker> unp, std::unique_ptr<swf::StreamReader> stream,
+        swf::Swf& movie, utils::TimePoints& tps);
+};
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "detfm/CompiledFmt.hpp"
 #include "utils.hpp"
 #include <abc/parser/Parser.hpp>
 #include <fmt/core.h>
@@ -7,17 +8,29 @@
 #include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 namespace athes::detfm {
 namespace abc = swf::abc;
 using json    = nlohmann::json;
 
+class ThreadPool;
+
 std::optional<std::string> check_format(std::string const& format, fmt::format_args args);
 struct StringFmtBase {
     std::string value;
+    CompiledFmt compiled; // value, parsed once
+
+    StringFmtBase(std::string value) : value(value), compiled(this->value) { }
+    StringFmtBase(const char* value) : value(value), compiled(this->value) { }
+    virtual ~StringFmtBase() = default;
 
-    StringFmtBase(std::string value) : value(value) { }
-    StringFmtBase(const char* value) : value(value) { }
+    /* Change the format, which must be valid */
+    void set(std::string format) {
+        value    = std::move(format);
+        compiled = CompiledFmt(value);
+    }
 
     virtual std::optional<std::string> valid(std::string const&) const = 0;
     std::optional<std::string> valid() const { return valid(value); }
@@ -34,7 +47,7 @@ template <typename... Types> struct StringFmt : public StringFmtBase {
             default_args);
     }
 
-    std::string format(Types... args) { return fmt::format(value, args...); }
+    std::string format(Types... args) const { return compiled.format(args...); }
 };
 
 class Fmt {
@@ -48,10 +61,10 @@ public:
     StringFmt<uint32_t> errors    = "error{:d}";
     StringFmt<uint32_t> symbols   = "ClassSymbol_{:d}";
 
-    StringFmt<uint8_t, uint8_t, std::string> clientbound_packet  = "CPacket{:02x}{:02x}{}";
-    StringFmt<uint8_t, uint8_t, std::string> serverbound_packet  = "SPacket{:02x}{:02x}{}";
-    StringFmt<uint16_t, std::string> tribulle_clientbound_packet = "TCPacket_{:04x}{}";
-    StringFmt<uint16_t, std::string> tribulle_serverbound_packet = "TSPacket_{:04x}{}";
+    StringFmt<uint8_t, uint8_t, std::string_view> clientbound_packet  = "CPacket{:02x}{:02x}{}";
+    StringFmt<uint8_t, uint8_t, std::string_view> serverbound_packet  = "SPacket{:02x}{:02x}{}";
+    StringFmt<uint16_t, std::string_view> tribulle_clientbound_packet = "TCPacket_{:04x}{}";
+    StringFmt<uint16_t, std::string_view> tribulle_serverbound_packet = "TSPacket_{:04x}{}";
 
     StringFmt<uint16_t> packet_subhandler          = "PacketSubHandler_{:02x}";
     StringFmt<uint16_t> unknown_clientbound_packet = "CPacket_u{:02d}";
@@ -69,27 +82,50 @@ protected:
 // Helper that renames invalid symbols using the format specified
 class Renamer {
 public:
-    Renamer(std::shared_ptr<abc::AbcFile> const& abc, Fmt const& fmt);
+    /* unprintable flags the pool's strings which are invalid, computed when not given */
+    Renamer(
+        std::shared_ptr<abc::AbcFile> const& abc, Fmt const& fmt,
+        std::vector<uint8_t> unprintable = {});
 
     static bool invalid(std::string const& name);
     static bool invalid(std::string_view name);
 
-    // Rename invalid symbols inside the abc file
-    void rename();
-    // Rename the class's name, its inherited class and all traits if invalids
-    void rename(abc::Class& klass);
-    // Rename the trait's name if invalid
-    void rename(abc::Trait& trait);
-    // Rename the method's exceptions and traits if invalids
-    void rename(abc::Method& method);
-    // Rename the exception variable's name to "error" if invalid
-    void rename(abc::Exception& err);
-    // Rename the exception variable's name to the specified counter if invalid
-    void rename(abc::Exception& err, int counter);
+    /* Rename invalid symbols inside the abc file: classes, traits and exception variables.
+     * The invalid symbols are looked for and their names formatted in parallel, the numbering
+     * follows the order of the classes then the methods */
+    void rename(ThreadPool& pool);
 
 private:
+    // A name to change, found by rename(ThreadPool&)
+    struct Pending {
+        enum class Target : uint8_t { klass, super, trait, error };
+
+        Target target;
+        void* object; // the class, trait or exception
+        uint32_t multiname;
+        int counter = 0; // the number in the new name, 0 for an exception named "error"
+        std::string name;
+    };
+
     std::shared_ptr<abc::AbcFile> abc;
     Fmt fmt;
+    std::vector<uint8_t> unprintable; // by string index
+
+    void find_invalid(abc::Class& klass, std::vector<Pending>& found);
+    void find_invalid(abc::Trait& trait, std::vector<Pending>& found);
+    void find_invalid(abc::Method& method, std::vector<Pending>& found);
+    /* The counter and format of the pending name, nullptr for exceptions: they're numbered per
+     * method */
+    std::pair<int*, StringFmt<uint32_t>*> numbering(Pending const& pending);
+    std::string new_name(Pending const& pending);
+    void apply(Pending& pending);
+
+    /* Whether the multiname's name is invalid, looked up by string index when possible */
+    template <typename Name> bool invalid(uint32_t multiname, Name const& name);
+    /* The multiname has been renamed to a valid name */
+    void validated(uint32_t multiname);
+    /* The string index of the multiname's name, if it has one */
+    bool name_index(uint32_t multiname, uint32_t& index) const;
     struct {
         int classes   = 0;
         int consts    = 0;
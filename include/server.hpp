@@ -0,0 +1,59 @@
+#pragma once
+#include "pipeline.hpp"
+#include "utils.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace athes::detfm {
+class Connection;
+
+/* Keeps the pipeline resident and deobfuscates the movies sent over a Unix socket.
+ * Each connection is handled by its own thread, one request at a time. At most max_requests are
+ * processed at once, the others wait for their turn. The parallel phases of concurrent requests
+ * share the pipeline's thread pool. Only a line per request is logged, not its progress.
+ *
+ * A request is a JSON object on a single line. It gives either the "input" (a path or an url), or
+ * the "size" of the movie whose bytes follow the line, up to the server's maximum. It may override
+ * the options "compression", "schedule", "unpack", "compact", "strip_dead_classes",
+ * "ignore_missing" and "proxy_port".
+ * The response is a JSON object on a single line with the "status", the exit code detfm would
+ * have returned. Upon success, it gives the "size" of the deobfuscated movie whose bytes follow.
+ */
+class Server {
+public:
+    Server(
+        Pipeline& pipeline, Options options, utils::Logger logger, size_t max_size,
+        size_t max_requests);
+
+    /* Listen on the socket, replacing a stale one. Only return upon error, with the exit code,
+     * once the connections are closed and their threads joined */
+    int serve(std::string const& path);
+
+private:
+    struct Worker {
+        int fd; // -1 once the connection is being closed
+        std::thread thread;
+    };
+
+    Pipeline& pipeline;
+    Options options;
+    utils::Logger logger;
+    size_t max_size; // of the movies sent over the socket
+    size_t max_requests;
+
+    std::mutex mutex;
+    std::condition_variable released;
+    size_t requests = 0; // being processed
+    std::list<Worker> workers;
+
+    /* Join the threads of the closed connections, or of all of them once they are shut down */
+    void reap(bool all);
+    void handle(Worker& worker);
+    /* Process a request. Return false when the connection can't be used anymore */
+    bool respond(Connection& conn, std::string const& line);
+};
+}
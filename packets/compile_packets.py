@@ -1,16 +1,46 @@
 import argparse
 import json
 import os
+import struct
 
-MAP_TYPE = "std::unordered_map<std::string, std::string>"
 HEADER = """
-#include <string>
-#include <unordered_map>
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
 
 namespace pktnames {
+struct Packet {
+    uint16_t code;
+    std::string_view name;
+};
+// Packets sorted by code
+struct Table {
+    Packet const* packets;
+    size_t size;
+};
 """.lstrip()
 
 
+def to_name(description: str) -> str:
+    """CamelCase the description, keeping only the letters, with a leading underscore"""
+    name = "_"
+    capitalize = True
+    for c in description:
+        if c in "_ ":
+            capitalize = True
+            continue
+
+        if not ("A" <= c <= "Z" or "a" <= c <= "z"):
+            continue
+
+        name += c.upper() if capitalize else c
+        capitalize = False
+
+    return name
+
+
 def validate_packets(packets):
     expected = "Expected packets to be dict[str, str]"
     if not isinstance(packets, dict):
@@ -26,23 +56,91 @@ def validate_packets(packets):
             error_message = f"{expected}, got value {value!r} instead"
             raise ValueError(error_message)
 
+        if len(key) != 4 or any(c not in "0123456789abcdefABCDEF" for c in key):
+            error_message = f"Packet codes must be 4 hexadecimal digits, got {key!r} instead"
+            raise ValueError(error_message)
+
         if '"' in key or '"' in value:
             error_message = f"Packets cannot key and values cannot contains quotes: key={key!r} value={value!r}"
             raise ValueError(error_message)
 
 
-def main(input_files: list[str], output_file: str):
+# Binary database loaded by detfm --packets, all the integers are little-endian:
+#  - header: magic, version, number of tables
+#  - tables: name (NUL-padded), number of packets, offset of the first packet
+#  - packets, sorted by code: code, name's length, name's offset
+#  - names, not NUL-terminated
+BINARY_MAGIC = b"DTFMPKT\0"
+BINARY_VERSION = 1
+BINARY_HEADER = struct.Struct("<8sII")
+BINARY_TABLE = struct.Struct("<32sII")
+BINARY_PACKET = struct.Struct("<HHI")
+
+
+def load_tables(input_files: list[str]):
+    tables = []
+    for file in input_files:
+        with open(file, "rb") as pkt_file:
+            packets = json.load(pkt_file)
+            validate_packets(packets)
+
+        name = os.path.splitext(os.path.basename(file))[0]
+        codes = sorted((int(k, 16), to_name(v)) for k, v in packets.items())
+
+        # The keys are only unique as strings: "0a0b" and "0A0B" are the same code
+        for (code, _), (next_code, _) in zip(codes, codes[1:]):
+            if code == next_code:
+                error_message = f"Packet code {code:04x} is given twice in {file}"
+                raise ValueError(error_message)
+
+        tables.append((name, codes))
+
+    return tables
+
+
+def write_binary(tables, output_file: str):
+    offset = BINARY_HEADER.size + BINARY_TABLE.size * len(tables)
+    names_offset = offset + BINARY_PACKET.size * sum(len(codes) for _, codes in tables)
+    header = [BINARY_HEADER.pack(BINARY_MAGIC, BINARY_VERSION, len(tables))]
+    packets = []
+    names = bytearray()
+    for name, codes in tables:
+        if len(name.encode()) >= 32:
+            error_message = f"Table names must be shorter than 32 bytes, got {name!r} instead"
+            raise ValueError(error_message)
+
+        header.append(BINARY_TABLE.pack(name.encode(), len(codes), offset))
+        offset += BINARY_PACKET.size * len(codes)
+        for code, pkt_name in codes:
+            encoded = pkt_name.encode()
+            packets.append(BINARY_PACKET.pack(code, len(encoded), names_offset + len(names)))
+            names += encoded
+
+    with open(output_file, "wb") as out:
+        out.writelines(header)
+        out.writelines(packets)
+        out.write(names)
+
+
+def main(input_files: list[str], output_file: str, binary: bool):
+    tables = load_tables(input_files)
+    if binary:
+        write_binary(tables, output_file)
+        return
+
     with open(output_file, "w") as out:
         out.write(HEADER)
-        for file in input_files:
-            with open(file, "rb") as pkt_file:
-                packets = json.load(pkt_file)
-                validate_packets(packets)
+        for name, codes in tables:
+            if not codes:
+                out.write(f"\ninline constexpr Table {name} = {{ nullptr, 0 }};\n")
+                continue
 
-            name = os.path.splitext(os.path.basename(file))[0]
-            out.write(f"static {MAP_TYPE} {name} = {{\n")
-            out.writelines(f'    {{ "{k}", "{v}" }},\n' for k, v in packets.items())
-            out.write("};\n\n")
+            out.write(f"\ninline constexpr Packet {name}_packets[] = {{\n")
+            out.writelines(f'    {{ 0x{code:04x}, "{pkt_name}" }},\n' for code, pkt_name in codes)
+            out.write("};\n")
+            out.write(
+                f"inline constexpr Table {name} = {{ {name}_packets, std::size({name}_packets) }};\n"
+            )
 
         out.write("}\n")
 
@@ -51,6 +149,11 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("input", nargs="+")
     parser.add_argument("-o", "--output", required=1)
+    parser.add_argument(
+        "--binary",
+        action="store_true",
+        help="Write a packet database to load with detfm --packets instead of a header",
+    )
     args = parser.parse_args()
 
-    main(args.input, args.output)
+    main(args.input, args.output, args.binary)
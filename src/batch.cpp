@@ -0,0 +1,103 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fmt/format.h>
+#include <fstream>
+#include <thread>
+
+namespace athes::detfm {
+Batch::Batch(Pipeline& pipeline, utils::Logger logger) : pipeline(pipeline), logger(logger) { }
+
+std::optional<std::string> Batch::read(std::string const& manifest) {
+    std::ifstream file(manifest);
+    if (!file)
+        return fmt::format("Unable to read the manifest {}", manifest);
+
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); ++number) {
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        // Paths containing spaces must be separated by a tab
+        const auto last = line.find_last_not_of(" \t\r");
+        line            = line.substr(first, last - first + 1);
+        auto sep        = line.find('\t');
+        if (sep == std::string::npos)
+            sep = line.find(' ');
+        if (sep == std::string::npos)
+            return fmt::format("{}:{}: expected an input and an output", manifest, number);
+
+        Entry entry;
+        entry.input  = line.substr(0, sep);
+        entry.output = line.substr(line.find_first_not_of(" \t", sep));
+        if (entry.input == "-" || entry.output == "-")
+            return fmt::format("{}:{}: can't use stdin or stdout in a batch", manifest, number);
+
+        entries.push_back(std::move(entry));
+    }
+    return std::nullopt;
+}
+
+int Batch::run(size_t in_flight) {
+    const auto workers = std::min(std::max<size_t>(in_flight, 1), entries.size());
+
+    // The progress messages are written piece by piece, those of concurrent files would be mixed
+    auto quiet = logger;
+    if (workers > 1)
+        quiet.level = std::max(quiet.level, utils::LogLevel::WARNING);
+
+    auto runner = pipeline.with(quiet);
+    std::vector<int> codes(entries.size(), 0);
+    std::atomic<size_t> next = 0;
+    const auto work          = [&] {
+        for (auto i = next++; i < entries.size(); i = next++)
+            codes[i] = process(runner, entries[i]);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers; ++i)
+        threads.emplace_back(work);
+
+    work();
+    for (auto& thread : threads)
+        thread.join();
+
+    const auto failed = std::count_if(codes.begin(), codes.end(), [](int code) { return code; });
+    if (failed != 0)
+        logger.error("{} of {} files failed.\n", failed, entries.size());
+
+    auto it = std::find_if(codes.begin(), codes.end(), [](int code) { return code != 0; });
+    return it != codes.end() ? *it : 0;
+}
+
+int Batch::process(Pipeline& pipeline, Entry const& entry) {
+    utils::TimePoints tps = { { "start", utils::now() } };
+    swf::Swf movie;
+    try {
+        int code = pipeline.load(entry.input, movie, tps);
+        if (code == 0)
+            code = pipeline.run(movie, tps);
+        if (code != 0) {
+            logger.error("{}: failed with exit code {}.\n", entry.input, code);
+            return code;
+        }
+
+        swf::StreamWriter writer;
+        pipeline.write(movie, writer);
+        writer.tofile(entry.output);
+    } catch (const std::exception& err) {
+        logger.error("{}: {}\n", entry.input, err.what());
+        return 2;
+    }
+
+    const auto took = utils::elapsled(tps.front().second, utils::now());
+    logger.info(
+        "{} -> {}: done ({}).\n",
+        entry.input,
+        entry.output,
+        utils::fmt_unit({ "µs", "ms", "s" }, took, 1000));
+    return 0;
+}
+}
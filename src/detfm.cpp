@@ -1,4 +1,6 @@
 #include "detfm.hpp"
+#include "detfm/Arena.hpp"
+#include "detfm/Bytecode.hpp"
 #include "detfm/common.hpp"
 #include "detfm/opinfo.hpp"
 #include "detfm/simplify.hpp"
@@ -33,18 +35,8 @@ bool is_qname(abc::Multiname& mn) {
     return mn.kind == abc::MultinameKind::QName || mn.kind == abc::MultinameKind::QNameA;
 }
 
-/** @brief Skip instructions until the specified opcode is reached.
- *  @return true upon success, false if it reached end of code.
- */
-bool skip_to_opcode(std::shared_ptr<Instruction>& ins, OP opcode) {
-    while (ins && ins->opcode != opcode)
-        ins = ins->next;
-
-    return ins != nullptr;
-}
-
-detfm::detfm(std::shared_ptr<abc::AbcFile>& abc, Fmt fmt, utils::Logger logger)
-    : logger(logger), fmt(fmt), abc(abc), ns_class_map() { }
+detfm::detfm(std::shared_ptr<abc::AbcFile>& abc, Fmt fmt, utils::Logger logger, ThreadPool& pool)
+    : logger(logger), fmt(fmt), abc(abc), pool(pool), code_cache(abc), ns_class_map() { }
 
 std::vector<std::string> detfm::analyze() {
     for (uint32_t i = 0; i < abc->cpool.multinames.size(); ++i) {
@@ -55,21 +47,47 @@ std::vector<std::string> detfm::analyze() {
         }
     }
 
-    std::list<std::pair<abc::Class**, std::function<bool(abc::Class & klass)>>> to_find = {
-        { &base_spkt, [this](abc::Class& cls) { return match_serverbound_pkt(cls); } },
-        { &base_cpkt, [this](abc::Class& cls) { return match_clientbound_pkt(cls); } },
-        { &pkt_hdlr, [this](abc::Class& cls) { return match_packet_handler(cls); } },
-        { &varint_reader, [this](abc::Class& cls) { return match_varint_reader(cls); } },
-        { &interface_proxy, [this](abc::Class& cls) { return match_interface_proxy(cls); } },
+    enum Match : uint8_t {
+        wrap   = 1 << 0,
+        slot   = 1 << 1,
+        spkt   = 1 << 2,
+        cpkt   = 1 << 3,
+        hdlr   = 1 << 4,
+        varint = 1 << 5,
+        proxy  = 1 << 6,
     };
-    for (auto& klass : abc->classes) {
-        if (match_wrap_class(klass)) {
-            wrap_class = std::make_unique<WrapClass>(klass);
-        } else if (match_slot_class(klass)) {
-            static_classes.classes.try_emplace(klass.name, abc, klass);
+    // Run the matchers in parallel, then pick the matches in order
+    std::vector<uint8_t> matches(abc->classes.size());
+    pool.parallel_for(abc->classes.size(), [this, &matches](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i) {
+            auto& klass = abc->classes[i];
+            matches[i]  = (match_wrap_class(klass) ? wrap : 0)
+                | (match_slot_class(klass) ? slot : 0)
+                | (match_serverbound_pkt(klass) ? spkt : 0)
+                | (match_clientbound_pkt(klass) ? cpkt : 0)
+                | (match_packet_handler(klass) ? hdlr : 0)
+                | (match_varint_reader(klass) ? varint : 0)
+                | (match_interface_proxy(klass) ? proxy : 0);
+        }
+    });
+
+    std::list<std::pair<abc::Class**, Match>> to_find = {
+        { &base_spkt, spkt },
+        { &base_cpkt, cpkt },
+        { &pkt_hdlr, hdlr },
+        { &varint_reader, varint },
+        { &interface_proxy, proxy },
+    };
+    std::vector<abc::Class*> slot_classes;
+    for (size_t i = 0; i < abc->classes.size(); ++i) {
+        auto& klass = abc->classes[i];
+        if (wrap_class == nullptr && (matches[i] & wrap)) {
+            wrap_class = std::make_unique<WrapClass>(klass, abc->cpool.multinames.size());
+        } else if (matches[i] & slot) {
+            slot_classes.push_back(&klass);
         } else {
             for (auto it = to_find.begin(); it != to_find.end(); ++it) {
-                if (it->second(klass)) {
+                if (matches[i] & it->second) {
                     *it->first = &klass;
                     to_find.erase(it);
                     break;
@@ -78,6 +96,18 @@ std::vector<std::string> detfm::analyze() {
         }
     }
 
+    // Evaluating the static classes' methods is the costly part
+    std::vector<StaticClass> evaluated(slot_classes.size());
+    pool.parallel_for(slot_classes.size(), [this, &slot_classes, &evaluated](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i)
+            evaluated[i] = StaticClass(abc, *slot_classes[i], code_cache);
+    });
+    for (size_t i = 0; i < slot_classes.size(); ++i)
+        static_classes.classes.try_emplace(slot_classes[i]->name, std::move(evaluated[i]));
+    static_classes.index(abc->cpool.multinames.size());
+
+    classes.build(*abc);
+
     std::vector<std::string> missings;
     if (ByteArray == 0)
         missings.push_back("ByteArray Multiname");
@@ -102,33 +132,116 @@ std::vector<std::string> detfm::analyze() {
 }
 
 void detfm::simplify_init() {
-    for (auto& cls : abc->classes) {
-        auto& method = abc->methods[cls.cinit];
-        auto name    = abc->str(cls.name);
+    PoolWriter writer(abc, pool.size());
+    std::vector<uint8_t> failed(abc->classes.size(), 0);
+    const auto simplify = [this, &writer, &failed](size_t i) {
+        auto& cls = abc->classes[i];
         try {
-            simplify_expressions(abc, method);
+            simplify_expressions(abc, abc->methods[cls.cinit], writer);
+            code_cache.invalidate(cls.cinit);
         } catch (std::runtime_error& e) {
+            auto name = abc->str(cls.name);
             logger.warn("Unable to simplify class initializer for {}: {}\n", name, e.what());
+            failed[i] = 1;
         }
+    };
+    pool.parallel_for(abc->classes.size(), [&simplify](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i)
+            simplify(i);
+    });
+
+    // Simplify again the initializers which needed new constants
+    std::vector<size_t> classes;
+    const auto methods = writer.commit();
+    for (size_t i = 0; i < abc->classes.size(); ++i) {
+        if (!failed[i] && std::binary_search(methods.begin(), methods.end(), abc->classes[i].cinit))
+            classes.push_back(i);
     }
+    pool.parallel_for(classes.size(), [&simplify, &classes](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i)
+            simplify(classes[i]);
+    });
 }
 
-void detfm::unscramble() {
-    for (auto& method : abc->methods)
-        unscramble(method);
+WorkBalance detfm::unscramble(Schedule schedule) {
+    auto& methods = abc->methods;
+    PoolWriter writer(abc, pool.size());
+    WorkBalance balance;
+
+    // The static methods' values are known beforehand, add them to the pool right away so the
+    // methods using them don't need to be unscrambled twice
+    for (auto& klass : abc->classes) {
+        auto static_class = static_classes.find(klass.name);
+        if (static_class == nullptr)
+            continue;
+
+        for (auto& trait : klass.ctraits) {
+            auto value = static_class->method(trait.name);
+            if (value == nullptr)
+                continue;
+
+            if (std::holds_alternative<double>(*value))
+                writer.add_double(std::get<double>(*value), 0);
+            else
+                writer.add_integer(std::get<int32_t>(*value), 0);
+        }
+    }
+    writer.commit();
+
+    // Only methods using the wrapper or a static class have something to unscramble
+    unscramble_filter.emplace(static_cast<uint32_t>(abc->cpool.multinames.size()));
+    for (auto& it : static_classes.classes)
+        unscramble_filter->add(OP::getlex, it.first);
+    if (wrap_class != nullptr) {
+        unscramble_filter->add(OP::getlex, wrap_class->name());
+        for (auto name : wrap_class->methods) {
+            unscramble_filter->add(OP::getproperty, name);
+            unscramble_filter->add(OP::callproperty, name);
+        }
+    }
+    skipped = 0;
+
+    if (schedule == Schedule::lpt) {
+        // Methods' sizes are very skewed, start with the biggest ones so they don't end up last
+        std::vector<uint64_t> costs;
+        costs.reserve(methods.size());
+        for (auto& method : methods)
+            costs.push_back(method.code.size());
+
+        balance = pool.parallel_for(costs, [&](size_t i) { unscramble(methods[i], writer); });
+    } else {
+        balance = pool.parallel_for(methods.size(), [&](WorkRange range) {
+            unscramble(methods.begin() + range.first, methods.begin() + range.last, writer);
+        });
+    }
+
+    // Unscramble again the methods which needed new constants, now that their indices are known.
+    // They are left untouched until all their constants are committed.
+    for (auto pending = writer.commit(); !pending.empty(); pending = writer.commit()) {
+        pool.parallel_for(pending.size(), [&](WorkRange range) {
+            for (auto i = range.first; i < range.last; ++i)
+                unscramble(methods[pending[i]], writer);
+        });
+    }
+    return balance;
 }
-void detfm::unscramble(MethodIterator first, MethodIterator last) {
+void detfm::unscramble(MethodIterator first, MethodIterator last, PoolWriter& writer) {
     for (auto it = first; it != last; ++it)
-        unscramble(*it);
+        unscramble(*it, writer);
 }
-void detfm::unscramble(abc::Method& method) {
+bool detfm::unscramble(abc::Method& method, PoolWriter& writer) {
     if (method.code.empty())
-        return;
+        return true;
+
+    if (unscramble_filter && !unscramble_filter->matches(method.code)) {
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
 
+    const auto index = static_cast<uint32_t>(&method - abc->methods.data());
     Parser parser(method);
-    std::unordered_map<uint32_t, std::shared_ptr<Instruction>> ops;
-    std::vector<ErrorInfo> exceptions;
-    OpRegister insreg;
+    Arena::Scope arena;
+    OpRegister insreg(parser, method, arena.resource());
 
     const auto is_call = [](std::shared_ptr<Instruction>& ins) {
         return ins->opcode == OP::call || ins->opcode == OP::getglobalscope;
@@ -136,41 +249,11 @@ void detfm::unscramble(abc::Method& method) {
 
     auto ins             = parser.begin;
     bool modified        = false;
+    bool complete        = true;
     int remove_next_call = 0;
 
-    // populate the instruction register
-    auto prev = insreg[ins->addr] = std::make_shared<OpInfo>(ins);
-    while ((ins = ins->next) != nullptr) {
-        insreg[ins->addr] = std::make_shared<OpInfo>(ins);
-        prev = prev->next = insreg[ins->addr];
-    }
-
-    ins = parser.begin;
-    while (ins) {
-        auto opinfo = insreg[ins->addr];
-
-        if (ins->isJump()) {
-            for (uint32_t offset : ins->args) {
-                auto it = insreg.find(offset);
-
-                // Invalid jump; jump to next instruction instead
-                if (it == insreg.end())
-                    offset = ins->next->addr;
-
-                auto target = insreg[offset];
-                opinfo->jumpsTo.push_back(target);
-                target->jumpsHere.insert(opinfo.get());
-            }
-        }
-        ins = ins->next;
-    }
-
-    for (auto& err : method.exceptions)
-        exceptions.emplace_back(err, insreg);
-
-    ins = parser.begin;
     while (ins) {
-        auto opinfo = insreg[ins->addr];
+        auto opinfo = insreg[ins];
 
         if (wrap_class->is_wrap(ins)) {
             opinfo->remove(parser, insreg);
@@ -183,15 +266,14 @@ void detfm::unscramble(abc::Method& method) {
             remove_next_call -= ins->opcode == OP::call;
             opinfo->remove(parser, insreg);
         } else if (ins->opcode == OP::getlex) {
-            if (static_classes.is_static_class(ins->args[0])) {
-                auto klass   = static_classes[ins->args[0]];
+            if (auto klass = static_classes.find(ins->args[0])) {
                 auto lastins = ins;
                 auto lastop  = opinfo;
 
                 ins    = ins->next;
-                opinfo = insreg[ins->addr];
-                if (klass.is_slot(ins)) {
-                    auto trait = klass.slots[ins->args[0]];
+                opinfo = insreg[ins];
+                if (klass->is_slot(ins)) {
+                    auto trait = klass->slot(ins->args[0]);
                     switch (trait->slot.kind) {
                     case 0x01:
                         opinfo->ins->opcode = OP::pushstring;
@@ -215,19 +297,16 @@ void detfm::unscramble(abc::Method& method) {
                     lastop->remove(parser, insreg);
 
                     modified = true;
-                } else if (klass.is_method(ins)) {
-                    // Make it thread-safe 🤓 thanks to this little guy 💂
-                    std::lock_guard<std::mutex> guard(add_value_mut);
-                    auto value          = klass.methods[ins->args[0]];
+                } else if (klass->is_method(ins)) {
+                    auto& value         = *klass->method(ins->args[0]);
                     bool is_double      = std::holds_alternative<double>(value);
+                    auto value_index    = is_double
+                           ? writer.add_double(std::get<double>(value), index)
+                           : writer.add_integer(std::get<int32_t>(value), index);
                     opinfo->ins->opcode = is_double ? OP::pushdouble : OP::pushint;
-                    opinfo->ins->args   = { static_cast<uint32_t>(
-                        is_double ? abc->cpool.doubles.size() : abc->cpool.integers.size()) };
+                    opinfo->ins->args   = { value_index.value_or(0) };
+                    complete &= value_index.has_value();
                     lastop->remove(parser, insreg);
-                    if (is_double)
-                        abc->cpool.doubles.push_back(std::get<double>(value));
-                    else
-                        abc->cpool.integers.push_back(std::get<int32_t>(value));
 
                     modified = true;
                 } else {
@@ -241,47 +320,20 @@ void detfm::unscramble(abc::Method& method) {
         ins = ins->next;
     }
 
-    if (modified) {
-        uint32_t pos = 0;
-
-        // re-compute the instructions position
-        ins = parser.begin;
-        while (ins) {
-            auto opinfo  = insreg[ins->addr];
-            opinfo->addr = pos;
-            pos += ins->size();
-            ins = ins->next;
-        }
-
-        ins = parser.begin;
-        while (ins) {
-            auto opinfo = insreg[ins->addr];
-
-            if (ins->isJump())
-                for (size_t i = 0; i < ins->args.size(); ++i)
-                    ins->args[i] = opinfo->jumpsTo[i]->addr;
-
-            ins = ins->next;
-        }
+    // Some values are not in the constant pool yet
+    if (!complete)
+        return false;
 
-        swf::StreamWriter stream;
-        ins = parser.begin;
-        while (ins) {
-            ins->write(stream);
-            ins = ins->next;
-        }
-        method.code.clear();
-        method.code.insert(
-            method.code.end(), stream.get_buffer(), stream.get_buffer() + stream.size());
-
-        for (size_t i = 0; i < method.exceptions.size(); ++i) {
-            method.exceptions[i].from   = exceptions[i].from->addr;
-            method.exceptions[i].to     = exceptions[i].to->addr;
-            method.exceptions[i].target = exceptions[i].target->addr;
-        }
+    if (modified) {
+        insreg.write(method);
+        code_cache.invalidate(index);
     }
+
+    return true;
 }
 
+size_t detfm::skipped_methods() const { return skipped.load(std::memory_order_relaxed); }
+
 void detfm::rename() {
     ns.slot  = create_package("com.obfuscate");
     ns.pkt   = create_package("packets");
@@ -331,20 +383,18 @@ void detfm::rename() {
 
             auto super_name = klass.get_super_name();
             if (super_name == spkt_name) {
-                Parser parser(abc->methods[klass.iinit]);
+                auto& code     = code_cache.get(klass.iinit);
                 uint32_t pcode = 0;
 
-                auto ins = parser.begin;
                 // Find the Packet's code
-                while (ins && ins->opcode != OP::constructsuper) {
-                    if (ins->opcode == OP::pushdouble)
+                for (uint32_t ins = 0; ins < code.size() && code.op(ins) != OP::constructsuper;
+                     ++ins) {
+                    if (code.op(ins) == OP::pushdouble)
                         pcode
-                            = pcode << 8 | static_cast<uint32_t>(abc->cpool.doubles[ins->args[0]]);
-
-                    ins = ins->next;
+                            = pcode << 8 | static_cast<uint32_t>(abc->cpool.doubles[code.arg(ins)]);
                 }
                 klass.rename(fmt.serverbound_packet.format(
-                    pcode >> 8, pcode & 0xff, get_known_name(pktnames::serverbound, pcode)));
+                    pcode >> 8, pcode & 0xff, get_known_name(packets.serverbound, pcode)));
 
                 set_class_ns(klass, ns.spkt);
             } else if (super_name == rpkt_name) {
@@ -362,6 +412,7 @@ void detfm::rename() {
         klass.rename(fmt::format("$StaticClass_{:02d}", ++counter));
         set_class_ns(klass, ns.slot);
         abc->methods[klass.cinit].code.clear();
+        code_cache.invalidate(klass.cinit);
     }
     auto& klass = *wrap_class->klass;
     klass.ctraits.clear();
@@ -382,30 +433,23 @@ void detfm::rename() {
     create_missing_sets();
 }
 
-std::string detfm::get_known_name(PacketMap const& lookup, std::string code) {
-    auto it = lookup.find(code.c_str());
-    if (it == lookup.end())
-        return "";
-
-    std::string name = "_";
-    bool capitalize  = true;
-    for (auto c : it->second) {
-        if (c == '_' || c == ' ') {
-            capitalize = true;
-            continue;
-        }
+std::vector<uint32_t> detfm::dead_classes() {
+    std::vector<uint32_t> classes;
+    for (auto& it : static_classes.classes)
+        classes.push_back(static_cast<uint32_t>(it.second.klass - abc->classes.data()));
+    if (wrap_class != nullptr)
+        classes.push_back(static_cast<uint32_t>(wrap_class->klass - abc->classes.data()));
 
-        if ((c < 'A' || c > 'Z') && (c < 'a' || c > 'z'))
-            continue;
+    std::sort(classes.begin(), classes.end());
+    return classes;
+}
 
-        name.push_back(capitalize ? std::toupper(c) : c);
-        capitalize = false;
-    }
+std::string_view detfm::get_known_name(pktnames::Table const& lookup, uint16_t code) {
+    auto end    = lookup.packets + lookup.size;
+    auto packet = std::lower_bound(
+        lookup.packets, end, code, [](auto& packet, uint16_t code) { return packet.code < code; });
 
-    return name;
-}
-std::string detfm::get_known_name(PacketMap const& lookup, uint16_t code) {
-    return get_known_name(lookup, fmt::format("{:0>4x}", code));
+    return packet != end && packet->code == code ? packet->name : std::string_view();
 }
 
 void detfm::find_clientbound_packets() {
@@ -414,37 +458,36 @@ void detfm::find_clientbound_packets() {
 
     const auto predicate = [this](auto& t) { return match_packet_handler(t); };
     const auto trait = std::find_if(pkt_hdlr->ctraits.begin(), pkt_hdlr->ctraits.end(), predicate);
-    auto& method     = abc->methods[trait->index];
     pkt_hdlr->rename("PacketHandler");
     trait->rename("handle_packet");
     set_class_ns(*pkt_hdlr, ns.pkt);
 
-    Parser parser(method);
-    auto ins = parser.begin;
+    auto& bytecode = code_cache.get(trait->index);
+    uint32_t ins   = 0;
     uint8_t category, code;
-    while (ins) {
+    while (ins < bytecode.size()) {
         category = code = 0;
-        if (ins->opcode == OP::getlex && ins->args[0] == pkt_hdlr->name) {
-            if (get_packet_code(ins, category)) {
-                auto target = ins->targets[0].lock();
+        if (bytecode.op(ins) == OP::getlex && bytecode.arg(ins) == pkt_hdlr->name) {
+            if (get_packet_code(bytecode, ins, category)) {
+                auto target = bytecode.target(ins);
                 auto found  = false;
 
-                ins = ins->next;
-                if (ins->opcode == OP::pushdouble)
-                    ins = ins->next;
+                ++ins;
+                if (bytecode.is(ins, OP::pushdouble))
+                    ++ins;
 
-                while (get_packet_code(ins, code)) {
-                    auto codetarget = ins->targets[0].lock();
+                while (get_packet_code(bytecode, ins, code)) {
+                    auto codetarget = bytecode.target(ins);
 
                     // Handle the tribulle packets
                     if (category == 0x3c && code == 0x03) {
-                        found = find_clientbound_tribulle(ins);
+                        found = find_clientbound_tribulle(bytecode, ins);
                         break;
                     }
 
-                    while (ins && ins->opcode != OP::returnvoid) {
-                        if (is_sequence(ins, new_class_seq)) {
-                            auto klass = find_class_by_name(ins->args[0]);
+                    while (ins < bytecode.size() && bytecode.op(ins) != OP::returnvoid) {
+                        if (bytecode.matches(ins, new_class_seq)) {
+                            auto klass = find_class_by_name(bytecode.arg(ins));
                             if (!klass
                                 || (!klass->itraits.empty() && is_buffer_trait(klass->itraits[0])))
                                 break;
@@ -452,113 +495,117 @@ void detfm::find_clientbound_packets() {
                             klass->rename(fmt.clientbound_packet.format(
                                 category,
                                 code,
-                                get_known_name(pktnames::clientbound, category << 8 | code)));
+                                get_known_name(packets.clientbound, category << 8 | code)));
                             set_class_ns(*klass, ns.cpkt);
                             break;
                         }
-                        ins = ins->next;
+                        ++ins;
                     }
 
                     ins   = codetarget;
                     found = true;
-                    if (ins->addr == target->addr)
+                    if (ins == target)
                         break;
 
-                    if (ins->opcode == OP::pushdouble)
-                        ins = ins->next;
+                    if (bytecode.is(ins, OP::pushdouble))
+                        ++ins;
                 }
 
-                if (!found && is_sequence(ins, sub_handler_seq)
-                    && ins->next->next->args[0] == pkt_hdlr->name) {
-                    auto handler = find_class_by_name(ins->args[0]);
+                if (!found && bytecode.matches(ins, sub_handler_seq)
+                    && bytecode.arg(ins + 2) == pkt_hdlr->name) {
+                    auto handler = find_class_by_name(bytecode.arg(ins));
 
                     if (handler) {
                         logger.info("Found sub handler ({})\n", handler->get_name());
                         find_clientbound_packets(*handler, trait->name, category);
                     }
                 }
-                ins = target->prev.lock();
+                // resume right before the target, the loop moves to it
+                ins = target > 0 ? target - 1 : bytecode.size();
             }
         }
-        ins = ins->next;
+        ++ins;
     }
 }
 void detfm::find_clientbound_packets(abc::Class& klass, uint32_t& trait_name, uint8_t& category) {
-    auto trait   = find_ctrait_by_name(klass, trait_name);
-    auto& method = abc->methods[trait->index];
+    auto trait = find_ctrait_by_name(klass, trait_name);
+    if (trait == nullptr)
+        return;
+
     uint8_t code = 0;
     klass.rename(fmt.packet_subhandler.format(category));
     set_class_ns(klass, ns.pkt);
 
-    Parser parser(method);
-    auto ins = parser.begin;
-    while (ins) {
-        if (ins->opcode == OP::getlocal2) {
-            auto tmp = ins->next->opcode == OP::pushdouble ? ins = ins->next : ins->prev.lock();
-
-            if (tmp->opcode == OP::pushdouble) {
-                code = static_cast<uint8_t>(abc->cpool.doubles[tmp->args[0]]);
-                if (ins->next->opcode == OP::ifne) {
-                    auto target = ins->next->targets[0].lock();
-
-                    ins = ins->next->next;
-                    while (ins && ins->opcode != OP::returnvoid) {
-                        if (is_sequence(ins, new_class_seq)) {
-                            auto klass = find_class_by_name(ins->args[0]);
+    auto& bytecode = code_cache.get(trait->index);
+    uint32_t ins   = 0;
+    while (ins < bytecode.size()) {
+        if (bytecode.op(ins) == OP::getlocal2) {
+            auto tmp = bytecode.is(ins + 1, OP::pushdouble) ? ++ins : ins - 1;
+
+            if (bytecode.is(tmp, OP::pushdouble)) {
+                code = static_cast<uint8_t>(abc->cpool.doubles[bytecode.arg(tmp)]);
+                if (bytecode.is(ins + 1, OP::ifne)) {
+                    auto target = bytecode.target(ins + 1);
+
+                    ins += 2;
+                    while (ins < bytecode.size() && bytecode.op(ins) != OP::returnvoid) {
+                        if (bytecode.matches(ins, new_class_seq)) {
+                            auto klass = find_class_by_name(bytecode.arg(ins));
                             if (klass) {
                                 klass->rename(fmt.clientbound_packet.format(
                                     category,
                                     code,
-                                    get_known_name(pktnames::clientbound, category << 8 | code)));
+                                    get_known_name(packets.clientbound, category << 8 | code)));
                                 set_class_ns(*klass, ns.cpkt);
                             }
                             break;
                         }
 
-                        if (ins->addr == target->addr)
+                        if (ins == target)
                             break;
 
-                        ins = ins->next;
+                        ++ins;
                     }
-                    ins = target->prev.lock();
+                    ins = target > 0 ? target - 1 : bytecode.size();
                 }
             }
         }
-        ins = ins->next;
+        ++ins;
     }
 }
 
-bool detfm::find_clientbound_tribulle(std::shared_ptr<Instruction> ins) {
-    std::optional<abc::Class> klass;
+bool detfm::find_clientbound_tribulle(Bytecode const& bytecode, uint32_t ins) {
+    abc::Class* klass = nullptr;
 
-    while (ins && ins->opcode != OP::returnvoid && !is_sequence(ins, tribulle_pkt_getter_seq))
-        ins = ins->next;
+    while (ins < bytecode.size() && bytecode.op(ins) != OP::returnvoid
+           && !bytecode.matches(ins, tribulle_pkt_getter_seq))
+        ++ins;
 
     // Safety check
-    if (ins->opcode == OP::returnvoid || !(klass = find_class_by_name(ins->args[0])))
+    if (ins >= bytecode.size() || bytecode.op(ins) == OP::returnvoid
+        || !(klass = find_class_by_name(bytecode.arg(ins))))
         return false;
 
-    auto callprop = ins->next->next->next;
-    auto trait    = find_ctrait_by_name(*klass, callprop->args[0]);
+    auto callprop = ins + 3;
+    auto trait    = find_ctrait_by_name(*klass, bytecode.arg(callprop));
 
     // Make sure we have a method!
     if (!trait || trait->kind != abc::TraitKind::Method)
         return false;
 
     // This method calls another one, which contains the code we want
-    Parser parser(abc->methods[trait->index]);
-    ins = parser.begin;
+    auto& getter = code_cache.get(trait->index);
 
     // First we have a getlex
-    if (!skip_to_opcode(ins, OP::getlex) || !(klass = find_class_by_name(ins->args[0])))
+    auto pos = getter.find(OP::getlex);
+    if (pos == getter.size() || !(klass = find_class_by_name(getter.arg(pos))))
         return false;
 
-    ins = ins->next;
+    ++pos;
     // then we should have 2 getproperty
-    while (ins && ins->opcode == OP::getproperty) {
-        auto name = abc->str(ins->args[0]);
+    while (getter.is(pos, OP::getproperty)) {
         // Make sure we get a slot trait with a specified type
-        if (!(trait = find_trait(*klass, ins->args[0])) || trait->kind != abc::TraitKind::Slot
+        if (!(trait = find_trait(*klass, getter.arg(pos))) || trait->kind != abc::TraitKind::Slot
             || trait->slot.type == 0)
             return false;
 
@@ -566,70 +613,70 @@ bool detfm::find_clientbound_tribulle(std::shared_ptr<Instruction> ins) {
         if (!(klass = find_class_by_name(trait->slot.type)))
             return false;
 
-        ins = ins->next;
+        ++pos;
     }
 
     // followed by some args and a callproperty
-    if (!skip_to_opcode(ins, OP::callproperty))
+    if ((pos = getter.find(OP::callproperty, pos)) == getter.size())
         return false;
 
     // Get the class & method
-    auto name = ins->args[0];
-    while (klass && !(trait = find_itrait_by_name(*klass, name, false)) && klass->super_name)
-        klass = find_class_by_name(klass->super_name);
+    auto name   = getter.arg(pos);
+    auto& chain = classes.chain(*klass);
+    auto owner  = std::find_if(chain.begin(), chain.end(), [this, name, &trait](abc::Class* cls) {
+        return (trait = find_itrait_by_name(*cls, name, false)) != nullptr;
+    });
 
-    if (!klass || !trait || trait->kind != abc::TraitKind::Method)
+    if (owner == chain.end() || trait->kind != abc::TraitKind::Method)
         return false;
 
+    klass = *owner;
+
     // The same class has several interesting stuff
     find_serverbound_tribulle(*klass);
 
     // found the magic method, we need to do the get_packet_code thing again!
     // but first let's rename the base packet
     auto& method = abc->methods[trait->index];
-    if ((klass = find_class_by_name(method.return_type)) != std::nullopt) {
+    if ((klass = find_class_by_name(method.return_type)) != nullptr) {
         set_class_ns(*klass, ns.tpkt);
         klass->rename("TCPacketBase");
     }
 
-    parser = Parser(method);
-    ins    = parser.begin;
-    if (!ins)
+    auto& code = code_cache.get(trait->index);
+    if (code.empty())
         return false;
 
     // similar to get_packet_code, but much simpler
     // it's always `local2 == <pushdouble>` (or inversed)
     // so we only need to find the pushdouble
-    uint16_t code;
-    do {
-        if (ins->opcode != OP::pushdouble)
+    for (pos = 0; pos < code.size(); ++pos) {
+        if (code.op(pos) != OP::pushdouble)
             continue;
 
-        code = abc->cpool.doubles[ins->args[0]];
+        uint16_t id = abc->cpool.doubles[code.arg(pos)];
         // find the next findpropstrict, that's the class we need to rename!
-        while (ins && ins->opcode != OP::findpropstrict)
-            ins = ins->next;
-
-        if (!ins || !(klass = find_class_by_name(ins->args[0])))
+        pos = code.find(OP::findpropstrict, pos);
+        if (pos == code.size() || !(klass = find_class_by_name(code.arg(pos))))
             continue; // should we return false?
 
         // rename it!
         set_class_ns(*klass, ns.tcpkt);
         klass->rename(fmt.tribulle_clientbound_packet.format(
-            code, get_known_name(pktnames::tribulle_clientbound, code)));
-    } while ((ins = ins->next) != nullptr);
+            id, get_known_name(packets.tribulle_clientbound, id)));
+    }
 
     return true;
 }
 
 void detfm::find_serverbound_tribulle(abc::Class& klass) {
     // First we can get the Tribulle aka Community Platform version
-    Parser parser(abc->methods[klass.iinit]);
-    auto ins = parser.begin;
+    auto& init = code_cache.get(klass.iinit);
+    auto pos = init.find(OP::pushstring);
 
     // Skip it if we don't find it, that's not the end of the world
-    if (skip_to_opcode(ins, OP::pushstring)) {
-        auto version = 'v' + abc->cpool.strings[ins->args[0]];
+    if (pos < init.size()) {
+        auto version = 'v' + abc->cpool.strings[init.arg(pos)];
         logger.info(
             "Found Tribulle {}\n",
             fmt::styled(version, fmt::emphasis::italic | fmt::fg(fmt::color::orchid)));
@@ -640,7 +687,7 @@ void detfm::find_serverbound_tribulle(abc::Class& klass) {
     // this class has a method called "getIdPaquet" which takes one param,
     // and return its corresponding id. The function check the param's type using `istypelate`
     // So we can get the class from its id and rename it.
-    std::optional<abc::Method> method;
+    abc::Method* method = nullptr;
 
     // don't search the trait from its name
     for (auto& trait : klass.itraits) {
@@ -651,152 +698,103 @@ void detfm::find_serverbound_tribulle(abc::Class& klass) {
         if (meth.params.size() != 1 || abc->qname(meth.return_type) != "int")
             continue;
 
-        method = meth;
+        method = &meth;
         trait.rename("getPacketId");
         break;
     }
 
-    if (!method)
+    if (method == nullptr)
         return;
 
-    parser = Parser(*method);
-    ins    = parser.begin;
+    auto& code = code_cache.get(*method);
+    uint32_t ins = 0;
 
-    std::unordered_map<uint32_t, uint16_t> addr2id;
+    std::unordered_map<uint32_t, uint16_t> pos2id;
     std::unordered_map<uint32_t, uint32_t> index2name;
-    while (ins && !is_sequence(ins, tribulle_pkt_return_id_seq))
-        ins = ins->next;
+    while (ins < code.size() && !code.matches(ins, tribulle_pkt_return_id_seq))
+        ++ins;
 
-    while (ins && is_sequence(ins, tribulle_pkt_return_id_seq)) {
-        addr2id[ins->addr] = static_cast<uint16_t>(abc->cpool.doubles[ins->next->args[0]]);
+    while (code.matches(ins, tribulle_pkt_return_id_seq)) {
+        pos2id[ins] = static_cast<uint16_t>(abc->cpool.doubles[code.arg(ins + 1)]);
         // Skip the sequence 💩
-        ins = ins->next->next->next;
+        ins += 3;
     }
 
     // find the getlex's and the index used in the lookupswitch
-    while (ins) {
+    while (ins < code.size()) {
         uint32_t name = 0;
-        if (skip_to_opcode(ins, OP::getlex))
-            name = ins->args[0];
+        if ((ins = code.find(OP::getlex, ins)) < code.size())
+            name = code.arg(ins);
 
-        if (skip_to_opcode(ins, OP::pushbyte)) {
-            index2name[ins->args[0]] = name;
+        if ((ins = code.find(OP::pushbyte, ins)) < code.size()) {
+            index2name[code.arg(ins)] = name;
 
-            if (!is_sequence(ins->next, { OP::jump, OP::getlocal1 }))
+            if (!code.matches(ins + 1, { OP::jump, OP::getlocal1 }))
                 break;
         }
     }
 
-    if (!skip_to_opcode(ins, OP::lookupswitch))
+    if ((ins = code.find(OP::lookupswitch, ins)) == code.size())
         return;
 
-    const auto targets_count = ins->targets.size();
-    std::optional<abc::Class> cls;
+    // The first target is the default one
+    const auto targets_count = code.ntargets(ins);
+    abc::Class* cls = nullptr;
     for (auto it : index2name) {
-        if (!(cls = find_class_by_name(it.second)) || it.first >= targets_count)
+        if (!(cls = find_class_by_name(it.second)) || it.first + 1 >= targets_count)
             continue;
 
-        auto addr = ins->targets[it.first + 1].lock()->addr;
-        if (addr2id.find(addr) == addr2id.end())
+        auto target = pos2id.find(code.target(ins, it.first + 1));
+        if (target == pos2id.end())
             continue;
 
-        auto code = addr2id[addr];
+        auto id = target->second;
         set_class_ns(*cls, ns.tspkt);
         cls->rename(fmt.tribulle_serverbound_packet.format(
-            code, get_known_name(pktnames::tribulle_serverbound, code)));
+            id, get_known_name(packets.tribulle_serverbound, id)));
     }
 }
 
-std::optional<abc::Class> detfm::find_class_by_name(uint32_t& name) {
-    auto klass = std::find_if(abc->classes.begin(), abc->classes.end(), [name](abc::Class& cls) {
-        return cls.name == name;
-    });
-
-    if (klass != abc->classes.end())
-        return *klass;
-
-    return {};
+abc::Class* detfm::find_class_by_name(uint32_t name) { return classes.find(name); }
+abc::Trait* detfm::find_ctrait_by_name(abc::Class& klass, uint32_t name, bool check_super) {
+    return classes.ctrait(klass, name, check_super);
 }
-std::optional<abc::Trait>
-detfm::find_ctrait_by_name(abc::Class& klass, uint32_t& name, bool check_super) {
-    auto trait = std::find_if(klass.ctraits.begin(), klass.ctraits.end(), [name](abc::Trait& t) {
-        return t.name == name;
-    });
-
-    if (trait != klass.ctraits.end())
-        return *trait;
-
-    if (!check_super || klass.super_name == 0)
-        return {};
-
-    // Check the prototype chain
-    // TODO: unroll it to prevent any recursive issue?
-    std::optional<abc::Class> super;
-    if ((super = find_class_by_name(klass.super_name)) != std::nullopt)
-        return find_ctrait_by_name(*super, name);
-
-    return {};
-}
-std::optional<abc::Trait>
-detfm::find_itrait_by_name(abc::Class& klass, uint32_t& name, bool check_super) {
-    for (auto& trait : klass.itraits)
-        if (trait.name == name)
-            return trait;
-
-    if (!check_super || klass.super_name == 0)
-        return {};
-
-    // Check the prototype chain
-    // TODO: unroll it to prevent any recursive issue?
-    std::optional<abc::Class> super;
-    if ((super = find_class_by_name(klass.super_name)) != std::nullopt)
-        return find_itrait_by_name(*super, name);
-
-    return {};
+abc::Trait* detfm::find_itrait_by_name(abc::Class& klass, uint32_t name, bool check_super) {
+    return classes.itrait(klass, name, check_super);
 }
-std::optional<abc::Trait> detfm::find_trait(abc::Class& klass, uint32_t& name) {
+abc::Trait* detfm::find_trait(abc::Class& klass, uint32_t name) {
     auto trait = find_ctrait_by_name(klass, name, false);
-    if (!trait)
+    if (trait == nullptr)
         trait = find_itrait_by_name(klass, name, false);
 
     return trait;
 }
 
-bool detfm::get_packet_code(std::shared_ptr<Instruction>& ins, uint8_t& code) {
+bool detfm::get_packet_code(Bytecode const& bytecode, uint32_t& ins, uint8_t& code) {
     auto lastins = ins;
-    if (ins->opcode != OP::getlex || ins->args[0] != pkt_hdlr->name)
+    if (!bytecode.is(ins, OP::getlex) || bytecode.arg(ins) != pkt_hdlr->name)
         return false;
 
-    if (!ins->next || ins->next->opcode != OP::getproperty)
+    if (!bytecode.is(ins + 1, OP::getproperty))
         return false;
 
-    ins = ins->next->next;
-    if (ins && ins->opcode == OP::pushdouble) {
-        code = static_cast<uint8_t>(abc->cpool.doubles[ins->args[0]]);
-        ins  = ins->next;
-        return ins && ins->opcode == OP::ifne;
+    ins += 2;
+    if (bytecode.is(ins, OP::pushdouble)) {
+        code = static_cast<uint8_t>(abc->cpool.doubles[bytecode.arg(ins)]);
+        ++ins;
+        return bytecode.is(ins, OP::ifne);
     }
 
     // the pushdouble could be right before
-    auto tmp = lastins->prev.lock();
-    if (tmp && tmp->opcode == OP::pushdouble) {
-        code = static_cast<uint8_t>(abc->cpool.doubles[tmp->args[0]]);
-        return ins && ins->opcode == OP::ifne;
+    if (lastins > 0 && bytecode.is(lastins - 1, OP::pushdouble)) {
+        code = static_cast<uint8_t>(abc->cpool.doubles[bytecode.arg(lastins - 1)]);
+        return bytecode.is(ins, OP::ifne);
     }
 
     ins = lastins;
     return false;
 }
 
-bool detfm::is_sequence(std::shared_ptr<Instruction> ins, const std::vector<OP>& ops) {
-    for (auto& op : ops) {
-        if (!ins || ins->opcode != op)
-            return false;
-        ins = ins->next;
-    }
-    return true;
-}
-
 bool detfm::match_serverbound_pkt(abc::Class& klass) {
     if (base_spkt != nullptr)
         return false;
@@ -921,7 +919,7 @@ void detfm::rename_writeany() {
             if (method.max_stack == method.local_count && method.max_stack <= 2
                 && method.init_scope_depth == method.max_scope_depth - 1
                 && method.return_type == base_spkt->name) {
-                Parser parser(method);
+                auto& code           = code_cache.get(trait.index);
                 std::set<OP> allowed = {
                     OP::getlocal0,
                     OP::getlocal1,
@@ -930,25 +928,23 @@ void detfm::rename_writeany() {
                 };
                 auto isAllowed = [&allowed](OP op) { return allowed.find(op) != allowed.end(); };
                 uint32_t name  = 0;
-                auto ins       = parser.begin;
-                while (ins) {
-                    if (ins->opcode == OP::getproperty) {
+                for (uint32_t ins = 0; ins < code.size(); ++ins) {
+                    if (code.op(ins) == OP::getproperty) {
                         // Make sure we get the buffer
-                        if (ins->args[0] != base_spkt->itraits[0].name)
+                        if (code.arg(ins) != base_spkt->itraits[0].name)
                             break;
 
-                    } else if (ins->opcode == OP::callpropvoid) {
+                    } else if (code.op(ins) == OP::callpropvoid) {
                         if (name == 0) {
-                            name = abc->cpool.multinames[ins->args[0]].get_name_index();
+                            name = abc->cpool.multinames[code.arg(ins)].get_name_index();
                         } else {
                             // two names !!
                             name = 0;
                             break;
                         }
-                    } else if (!isAllowed(ins->opcode)) {
+                    } else if (!isAllowed(code.op(ins))) {
                         break;
                     }
-                    ins = ins->next;
                 }
 
                 // If we got a name, rename the trait with it. Do not use trait.name =
@@ -972,13 +968,12 @@ void detfm::rename_readany() {
         auto& method = abc->methods[trait.index];
         if (method.params.empty() && method.local_count == 1 && method.max_stack <= 2
             && method.init_scope_depth == method.max_scope_depth - 1) {
-            Parser parser(method);
-            auto ins = parser.begin;
-            if (!skip_to_opcode(ins, OP::getproperty)
-                || ins->args[0] != varint_reader->itraits[0].name)
+            auto& code = code_cache.get(trait.index);
+            auto ins   = code.find(OP::getproperty);
+            if (ins == code.size() || code.arg(ins) != varint_reader->itraits[0].name)
                 continue;
 
-            if (!ins->next || ins->next->opcode != OP::callproperty)
+            if (!code.is(ins + 1, OP::callproperty))
                 continue;
 
             std::string name;
@@ -987,7 +982,7 @@ void detfm::rename_readany() {
             if (abc->qname(method.return_type) == "Boolean") {
                 name = "readBoolean";
             } else {
-                auto mn = abc->cpool.multinames[ins->next->args[0]];
+                auto mn = abc->cpool.multinames[code.arg(ins + 1)];
                 name    = abc->cpool.strings[mn.get_name_index()];
             }
             trait.rename(name);
@@ -1003,19 +998,18 @@ void detfm::rename_interface_proxy() {
         return;
 
     interface_proxy->rename("InterfaceProxy");
-    auto& ctor = abc->methods[interface_proxy->iinit];
-    Parser parser(ctor);
+    auto& code = code_cache.get(interface_proxy->iinit);
 
-    auto ins = parser.begin;
-    while (ins) {
-        if (!skip_to_opcode(ins, OP::pushstring))
+    uint32_t ins = 0;
+    while (ins < code.size()) {
+        if ((ins = code.find(OP::pushstring, ins)) == code.size())
             break;
 
-        auto key = ins->args[0];
-        if (!skip_to_opcode(ins, OP::getproperty))
+        auto key = code.arg(ins);
+        if ((ins = code.find(OP::getproperty, ins)) == code.size())
             break;
 
-        auto& mn  = abc->cpool.multinames[ins->args[0]];
+        auto& mn  = abc->cpool.multinames[code.arg(ins)];
         auto name = abc->str(mn);
         for (auto& prefix : { "method_", "name_", "const_" }) {
             if (name.rfind(prefix, 0) == 0) {
@@ -1076,37 +1070,50 @@ uint32_t detfm::create_package(std::string name) {
 }
 
 void detfm::create_missing_sets() {
-    std::unordered_map<uint32_t, uint32_t> ns_set_cache;
+    auto& multinames = abc->cpool.multinames;
+    // QNames are updated in parallel, the multinames' namespace sets have to be created in order
+    std::vector<uint32_t> multiname_ns(multinames.size(), 0);
+    pool.parallel_for(multinames.size(), [this, &multinames, &multiname_ns](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i) {
+            auto& mn = multinames[i];
+            switch (mn.kind) {
+            case abc::MultinameKind::QName:
+            case abc::MultinameKind::QNameA: {
+                const auto& it = ns_class_map.find(mn.data.qname.name);
+                if (it != ns_class_map.end()) {
+                    mn.data.qname.ns = it->second;
+                }
+                break;
+            }
+            case abc::MultinameKind::Multiname: {
+                const auto& it = ns_class_map.find(mn.data.multiname.name);
+                if (it != ns_class_map.end())
+                    multiname_ns[i] = it->second;
 
-    for (auto& mn : abc->cpool.multinames) {
-        switch (mn.kind) {
-        case abc::MultinameKind::QName:
-        case abc::MultinameKind::QNameA: {
-            const auto& it = ns_class_map.find(mn.data.qname.name);
-            if (it != ns_class_map.end()) {
-                mn.data.qname.ns = it->second;
+                break;
             }
-            break;
-        }
-        case abc::MultinameKind::Multiname: {
-            const auto& it = ns_class_map.find(mn.data.multiname.name);
-            if (it != ns_class_map.end()) {
-                // Also change the namespace on other multinames using the same name
-                auto cached_set = ns_set_cache.find(it->second);
-                bool use_cached = cached_set != ns_set_cache.end();
-                uint32_t ns_set = use_cached ? cached_set->second : abc->cpool.ns_sets.size();
-
-                if (!use_cached) {
-                    abc->cpool.ns_sets.push_back({ it->second });
-                    ns_set_cache[it->second] = ns_set;
-                }
-                mn.data.multiname.ns_set = ns_set;
+            default:
+                break;
             }
-            break;
         }
-        default:
-            break;
+    });
+
+    std::unordered_map<uint32_t, uint32_t> ns_set_cache;
+    for (size_t i = 0; i < multinames.size(); ++i) {
+        const auto ns = multiname_ns[i];
+        if (ns == 0)
+            continue;
+
+        // Also change the namespace on other multinames using the same name
+        auto cached_set = ns_set_cache.find(ns);
+        bool use_cached = cached_set != ns_set_cache.end();
+        uint32_t ns_set = use_cached ? cached_set->second : abc->cpool.ns_sets.size();
+
+        if (!use_cached) {
+            abc->cpool.ns_sets.push_back({ ns });
+            ns_set_cache[ns] = ns_set;
         }
+        multinames[i].data.multiname.ns_set = ns_set;
     }
 }
 }
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "detfm/Arena.hpp"
+#include <new>
+
+namespace athes::detfm {
+void* Arena::Overflow::do_allocate(size_t bytes, size_t alignment) {
+    allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+void Arena::Overflow::do_deallocate(void* ptr, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+}
+bool Arena::Overflow::do_is_equal(std::pmr::memory_resource const& other) const noexcept {
+    return this == &other;
+}
+
+Arena::Arena(size_t capacity) : capacity(capacity) { reset(); }
+
+Arena& Arena::local() {
+    thread_local Arena arena;
+    return arena;
+}
+
+void Arena::reset() {
+    // Release the overflow first, it may be reallocated below
+    memory.reset();
+    if (overflow.allocated > 0 || buffer == nullptr) {
+        capacity += overflow.allocated;
+        buffer             = std::make_unique<std::byte[]>(capacity);
+        overflow.allocated = 0;
+    }
+    memory.emplace(buffer.get(), capacity, &overflow);
+}
+
+Arena::Scope::Scope() : arena(Arena::local()) { }
+Arena::Scope::~Scope() { arena.reset(); }
+
+std::pmr::memory_resource* Arena::Scope::resource() const { return &*arena.memory; }
+}
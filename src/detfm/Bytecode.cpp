@@ -0,0 +1,49 @@
+#include "detfm/Bytecode.hpp"
+#include <abc/parser/Instruction.hpp>
+#include <abc/parser/Parser.hpp>
+
+namespace athes::detfm {
+using swf::abc::parser::Parser;
+
+Bytecode::Bytecode(abc::Method& method) {
+    arg_offsets.push_back(0);
+    target_offsets.push_back(0);
+    if (method.code.empty())
+        return;
+
+    Parser parser(method);
+    std::vector<uint32_t> positions(method.code.size() + 1, 0);
+    for (auto ins = parser.begin; ins; ins = ins->next) {
+        if (ins->addr < positions.size())
+            positions[ins->addr] = size();
+
+        opcodes.push_back(ins->opcode);
+        addrs.push_back(ins->addr);
+        args.insert(args.end(), ins->args.begin(), ins->args.end());
+        arg_offsets.push_back(static_cast<uint32_t>(args.size()));
+    }
+
+    // Targets are resolved once every position is known
+    for (auto ins = parser.begin; ins; ins = ins->next) {
+        for (auto& target : ins->targets) {
+            auto locked = target.lock();
+            targets.push_back(
+                locked && locked->addr < positions.size() ? positions[locked->addr] : size());
+        }
+        target_offsets.push_back(static_cast<uint32_t>(targets.size()));
+    }
+}
+
+uint32_t Bytecode::find(OP opcode, uint32_t pos) const {
+    while (pos < size() && opcodes[pos] != opcode)
+        ++pos;
+    return pos;
+}
+
+bool Bytecode::matches(uint32_t pos, std::vector<OP> const& sequence) const {
+    for (auto opcode : sequence)
+        if (!is(pos++, opcode))
+            return false;
+    return true;
+}
+}
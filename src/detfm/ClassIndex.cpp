@@ -0,0 +1,87 @@
+#include "detfm/ClassIndex.hpp"
+
+namespace athes::detfm {
+void ClassIndex::build(abc::AbcFile& abc) {
+    first = abc.classes.data();
+    entries.assign(abc.classes.size(), Entry());
+
+    // Several classes may share a name, the first one wins
+    by_name.assign(abc.cpool.multinames.size(), nullptr);
+    for (auto& klass : abc.classes)
+        if (klass.name < by_name.size() && by_name[klass.name] == nullptr)
+            by_name[klass.name] = &klass;
+}
+
+abc::Class* ClassIndex::find(uint32_t name) const {
+    return name < by_name.size() ? by_name[name] : nullptr;
+}
+
+ClassIndex::Entry& ClassIndex::entry(abc::Class& klass) { return entries[&klass - first]; }
+
+ClassIndex::Entry& ClassIndex::indexed(abc::Class& klass) {
+    auto& entry = this->entry(klass);
+    if (!entry.indexed) {
+        // Keep the first trait of a name, like a linear search would
+        for (auto& trait : klass.ctraits)
+            entry.ctraits.emplace(trait.name, &trait);
+        for (auto& trait : klass.itraits)
+            entry.itraits.emplace(trait.name, &trait);
+
+        entry.indexed = true;
+    }
+    return entry;
+}
+
+std::vector<abc::Class*> const& ClassIndex::chain(abc::Class& klass) {
+    // Walk up to the first class whose chain is known, then fill the chains back down
+    std::vector<abc::Class*> path;
+    for (auto cls = &klass; cls != nullptr && !entry(*cls).chained; cls = find(cls->super_name)) {
+        auto& current = entry(*cls);
+        // A class inheriting from itself: the chain stops before the loop
+        if (current.visiting)
+            break;
+
+        current.visiting = true;
+        path.push_back(cls);
+        if (cls->super_name == 0)
+            break;
+    }
+
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        auto& current = entry(**it);
+        auto super    = (*it)->super_name != 0 ? find((*it)->super_name) : nullptr;
+        current.chain = { *it };
+        if (super != nullptr && entry(*super).chained)
+            current.chain.insert(
+                current.chain.end(), entry(*super).chain.begin(), entry(*super).chain.end());
+
+        current.chained  = true;
+        current.visiting = false;
+    }
+    return entry(klass).chain;
+}
+
+abc::Trait* ClassIndex::lookup(
+    abc::Class& klass, uint32_t name, bool check_super, Traits Entry::*traits) {
+    if (!check_super) {
+        auto& found = indexed(klass).*traits;
+        auto it     = found.find(name);
+        return it != found.end() ? it->second : nullptr;
+    }
+
+    for (auto cls : chain(klass)) {
+        auto& found = indexed(*cls).*traits;
+        auto it     = found.find(name);
+        if (it != found.end())
+            return it->second;
+    }
+    return nullptr;
+}
+
+abc::Trait* ClassIndex::ctrait(abc::Class& klass, uint32_t name, bool check_super) {
+    return lookup(klass, name, check_super, &Entry::ctraits);
+}
+abc::Trait* ClassIndex::itrait(abc::Class& klass, uint32_t name, bool check_super) {
+    return lookup(klass, name, check_super, &Entry::itraits);
+}
+}
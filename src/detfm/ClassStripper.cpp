@@ -0,0 +1,352 @@
+#include "detfm/ClassStripper.hpp"
+#include "detfm/code.hpp"
+#include <abc/parser/Parser.hpp>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace athes::detfm {
+using namespace swf::abc::parser;
+
+static bool is_method_trait(abc::Trait& trait) {
+    switch (trait.kind) {
+    case abc::TraitKind::Method:
+    case abc::TraitKind::Getter:
+    case abc::TraitKind::Setter:
+    case abc::TraitKind::Function:
+        return true;
+    default:
+        return false;
+    }
+}
+static bool takes_multiname(OP opcode) {
+    switch (opcode) {
+    case OP::getsuper:
+    case OP::setsuper:
+    case OP::getdescendants:
+    case OP::findpropstrict:
+    case OP::findproperty:
+    case OP::finddef:
+    case OP::getlex:
+    case OP::setproperty:
+    case OP::getproperty:
+    case OP::initproperty:
+    case OP::deleteproperty:
+    case OP::callproperty:
+    case OP::callproplex:
+    case OP::callpropvoid:
+    case OP::callsuper:
+    case OP::callsupervoid:
+    case OP::constructprop:
+    case OP::coerce:
+    case OP::astype:
+    case OP::istype:
+        return true;
+    default:
+        return false;
+    }
+}
+static bool takes_index(OP opcode) {
+    return opcode == OP::newclass || opcode == OP::newfunction || opcode == OP::callstatic;
+}
+
+/* Erase the flagged values, keeping the others in order */
+template <typename T, typename Flag>
+static void erase_flagged(std::vector<T>& values, std::vector<Flag> const& flags) {
+    size_t kept = 0;
+    for (size_t i = 0; i < values.size(); ++i)
+        if (!flags[i])
+            values[kept++] = std::move(values[i]);
+
+    values.erase(values.begin() + kept, values.end());
+}
+/* New index of each value once the flagged ones are erased */
+template <typename Flag>
+static std::vector<uint32_t> remap_flagged(std::vector<Flag> const& flags) {
+    std::vector<uint32_t> remap(flags.size(), 0);
+    uint32_t index = 0;
+    for (size_t i = 0; i < flags.size(); ++i)
+        remap[i] = flags[i] ? 0 : index++;
+
+    return remap;
+}
+
+ClassStripper::ClassStripper(std::shared_ptr<abc::AbcFile> const& abc, ThreadPool& pool)
+    : abc(abc), pool(pool) { }
+
+std::vector<uint8_t> ClassStripper::dead_scripts(std::vector<uint8_t>& classes) const {
+    auto& scripts = abc->scripts;
+    std::vector<uint8_t> dead(scripts.size(), 0);
+    std::vector<uint8_t> defined(classes.size(), 0);
+
+    // The last script is the entry point, never remove it
+    for (size_t i = 0; i + 1 < scripts.size(); ++i) {
+        auto& traits = scripts[i].traits;
+        dead[i]      = !traits.empty();
+        for (auto& trait : traits)
+            if (trait.kind != abc::TraitKind::Class || trait.index >= classes.size()
+                || !classes[trait.index])
+                dead[i] = 0;
+
+        if (dead[i])
+            for (auto& trait : traits)
+                defined[trait.index] = 1;
+    }
+
+    for (size_t i = 0; i < classes.size(); ++i)
+        classes[i] &= defined[i];
+
+    return dead;
+}
+
+std::vector<uint32_t> ClassStripper::dead_methods(
+    std::vector<uint8_t> const& classes, std::vector<uint8_t> const& scripts) const {
+    auto& methods = abc->methods;
+    std::vector<uint32_t> owners(methods.size(), 0);
+    std::vector<uint32_t> pending;
+
+    const auto own = [&](uint32_t method, uint32_t klass) {
+        if (method < owners.size() && owners[method] == 0) {
+            owners[method] = klass;
+            pending.push_back(method);
+        }
+    };
+
+    for (uint32_t i = 0; i < classes.size(); ++i) {
+        if (!classes[i])
+            continue;
+
+        auto& klass = abc->classes[i];
+        own(klass.iinit, i);
+        own(klass.cinit, i);
+        for (auto traits : { &klass.itraits, &klass.ctraits })
+            for (auto& trait : *traits)
+                if (is_method_trait(trait))
+                    own(trait.index, i);
+    }
+    for (size_t i = 0; i < scripts.size(); ++i)
+        if (scripts[i])
+            own(abc->scripts[i].init, abc->scripts[i].traits[0].index);
+
+    // Closures belong to the method creating them
+    while (!pending.empty()) {
+        const auto index = pending.back();
+        pending.pop_back();
+        if (methods[index].code.empty())
+            continue;
+
+        Parser parser(methods[index]);
+        for (auto ins = parser.begin; ins; ins = ins->next)
+            if (ins->opcode == OP::newfunction)
+                own(ins->args[0], owners[index]);
+    }
+    return owners;
+}
+
+bool ClassStripper::keep_referenced(
+    std::vector<uint8_t>& classes, std::vector<uint32_t> const& owners,
+    std::vector<uint8_t>& has_refs) {
+    auto& cpool   = abc->cpool;
+    auto& methods = abc->methods;
+
+    // Class referred by each multiname, by name. 0 for none, the first class is never removed.
+    std::unordered_map<std::string_view, uint32_t> names;
+    for (uint32_t i = 0; i < classes.size(); ++i) {
+        if (classes[i]) {
+            auto& mn = cpool.multinames[abc->classes[i].name];
+            names.emplace(cpool.strings[mn.get_name_index()], i);
+        }
+    }
+
+    std::vector<uint32_t> mn_class(cpool.multinames.size(), 0);
+    for (size_t i = 0; i < cpool.multinames.size(); ++i) {
+        auto& mn = cpool.multinames[i];
+        switch (mn.kind) {
+        case abc::MultinameKind::QName:
+        case abc::MultinameKind::QNameA:
+        case abc::MultinameKind::Multiname:
+        case abc::MultinameKind::MultinameA: {
+            auto it = names.find(cpool.strings[mn.get_name_index()]);
+            if (it != names.end())
+                mn_class[i] = it->second;
+
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> workers(
+        pool.size(), std::vector<uint8_t>(classes.size(), 0));
+    const auto refer = [&mn_class](std::vector<uint8_t>& referenced, uint32_t mn) {
+        if (mn < mn_class.size() && mn_class[mn] != 0)
+            referenced[mn_class[mn]] = 1;
+    };
+
+    pool.parallel_for(methods.size(), [&](WorkRange range) {
+        auto& referenced = workers[ThreadPool::worker()];
+        for (auto i = range.first; i < range.last; ++i) {
+            has_refs[i] = 0;
+            if (owners[i] != 0 || methods[i].code.empty())
+                continue;
+
+            Parser parser(methods[i]);
+            for (auto ins = parser.begin; ins; ins = ins->next) {
+                if (ins->args.empty())
+                    continue;
+
+                const auto arg = ins->args[0];
+                if (takes_multiname(ins->opcode)) {
+                    refer(referenced, arg);
+                } else if (ins->opcode == OP::newclass) {
+                    has_refs[i] = 1;
+                    if (arg < classes.size())
+                        referenced[arg] = 1;
+                } else if (takes_index(ins->opcode)) {
+                    has_refs[i] = 1;
+                    if (arg < owners.size() && owners[arg] != 0)
+                        referenced[owners[arg]] = 1;
+                }
+            }
+        }
+    });
+
+    // Types used by the live classes and methods
+    auto& referenced = workers[0];
+    for (uint32_t i = 0; i < classes.size(); ++i) {
+        if (classes[i])
+            continue;
+
+        auto& klass = abc->classes[i];
+        refer(referenced, klass.super_name);
+        for (auto mn : klass.interfaces)
+            refer(referenced, mn);
+        for (auto traits : { &klass.itraits, &klass.ctraits })
+            for (auto& trait : *traits)
+                if (trait.kind == abc::TraitKind::Slot || trait.kind == abc::TraitKind::Const)
+                    refer(referenced, trait.slot.type);
+    }
+    for (size_t i = 0; i < methods.size(); ++i) {
+        if (owners[i] != 0)
+            continue;
+
+        refer(referenced, methods[i].return_type);
+        for (auto mn : methods[i].params)
+            refer(referenced, mn);
+        for (auto& exception : methods[i].exceptions)
+            refer(referenced, exception.exc_type);
+        for (auto& trait : methods[i].traits)
+            if (trait.kind == abc::TraitKind::Slot || trait.kind == abc::TraitKind::Const)
+                refer(referenced, trait.slot.type);
+    }
+
+    bool kept = false;
+    for (size_t i = 0; i < classes.size(); ++i) {
+        for (auto& local : workers) {
+            if (classes[i] && local[i]) {
+                classes[i] = 0;
+                kept       = true;
+            }
+        }
+    }
+    return kept;
+}
+
+void ClassStripper::remove(
+    std::vector<uint8_t> const& classes, std::vector<uint32_t> const& owners,
+    std::vector<uint8_t> const& scripts, std::vector<uint8_t>& has_refs) {
+    const auto class_remap  = remap_flagged(classes);
+    const auto method_remap = remap_flagged(owners);
+
+    erase_flagged(abc->classes, classes);
+    erase_flagged(abc->methods, owners);
+    erase_flagged(abc->scripts, scripts);
+    erase_flagged(has_refs, owners);
+
+    for (auto& klass : abc->classes) {
+        klass.iinit = method_remap[klass.iinit];
+        klass.cinit = method_remap[klass.cinit];
+    }
+    for (auto& script : abc->scripts)
+        script.init = method_remap[script.init];
+
+    for_each_trait(*abc, [&](abc::Trait& trait) {
+        if (trait.kind == abc::TraitKind::Class)
+            trait.index = class_remap[trait.index];
+        else if (is_method_trait(trait))
+            trait.index = method_remap[trait.index];
+    });
+
+    auto& methods = abc->methods;
+    pool.parallel_for(methods.size(), [&](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i) {
+            if (!has_refs[i])
+                continue;
+
+            Parser parser(methods[i]);
+            bool modified = false;
+            for (auto ins = parser.begin; ins; ins = ins->next) {
+                if (!takes_index(ins->opcode) || ins->args.empty())
+                    continue;
+
+                auto& remap     = ins->opcode == OP::newclass ? class_remap : method_remap;
+                const auto prev = ins->args[0];
+                if (prev < remap.size())
+                    ins->args[0] = remap[prev];
+
+                modified |= ins->args[0] != prev;
+            }
+
+            // The operands' size may have changed
+            if (modified)
+                write_code(methods[i], parser);
+        }
+    });
+}
+
+std::string ClassStripper::qualified_name(abc::Class& klass) const {
+    auto& cpool = abc->cpool;
+    auto name   = klass.get_name();
+    auto ns     = cpool.multinames[klass.name].data.qname.ns;
+    if (ns == 0 || ns >= cpool.namespaces.size())
+        return name;
+
+    // Classes of the top-level package have no prefix
+    auto& package = cpool.strings[cpool.namespaces[ns].name];
+    return package.empty() ? name : package + "." + name;
+}
+
+ClassStripper::Stats ClassStripper::strip(std::vector<uint32_t> const& candidates) {
+    std::vector<uint8_t> classes(abc->classes.size(), 0);
+    for (auto index : candidates)
+        if (index > 0 && index < classes.size())
+            classes[index] = 1;
+
+    std::vector<uint8_t> scripts;
+    std::vector<uint32_t> owners;
+    std::vector<uint8_t> has_refs(abc->methods.size(), 0);
+    // Keeping a class keeps its methods alive, which may refer to other classes
+    do {
+        scripts = dead_scripts(classes);
+        owners  = dead_methods(classes, scripts);
+    } while (keep_referenced(classes, owners, has_refs));
+
+    Stats stats;
+    for (size_t i = 0; i < classes.size(); ++i) {
+        if (classes[i]) {
+            stats.names.push_back(qualified_name(abc->classes[i]));
+            ++stats.classes;
+        }
+    }
+    for (auto owner : owners)
+        stats.methods += owner != 0;
+    for (auto script : scripts)
+        stats.scripts += script;
+
+    if (stats.classes != 0)
+        remove(classes, owners, scripts, has_refs);
+
+    return stats;
+}
+}
@@ -0,0 +1,22 @@
+#include "detfm/CodeCache.hpp"
+
+namespace athes::detfm {
+CodeCache::CodeCache(std::shared_ptr<abc::AbcFile> const& abc)
+    : abc(abc), methods(abc->methods.size()) { }
+
+Bytecode const& CodeCache::get(uint32_t method) {
+    auto& entry = methods[method];
+    if (entry == nullptr)
+        entry = std::make_unique<Bytecode>(abc->methods[method]);
+
+    return *entry;
+}
+Bytecode const& CodeCache::get(abc::Method& method) { return get(index_of(method)); }
+
+void CodeCache::invalidate(uint32_t method) { methods[method].reset(); }
+void CodeCache::invalidate(abc::Method& method) { invalidate(index_of(method)); }
+
+uint32_t CodeCache::index_of(abc::Method& method) const {
+    return static_cast<uint32_t>(&method - abc->methods.data());
+}
+}
@@ -0,0 +1,106 @@
+#include "detfm/CompiledFmt.hpp"
+#include <cctype>
+
+namespace athes::detfm {
+CompiledFmt::CompiledFmt(std::string_view format) {
+    int next_arg = 0;
+    Segment literal;
+    for (size_t pos = 0; pos < format.size(); ++pos) {
+        const char c = format[pos];
+        // Escaped braces
+        if ((c == '{' || c == '}') && pos + 1 < format.size() && format[pos + 1] == c) {
+            literal.text += c;
+            ++pos;
+            continue;
+        }
+        if (c != '{') {
+            literal.text += c;
+            continue;
+        }
+
+        const auto end = format.find('}', pos);
+        if (end == std::string_view::npos) {
+            literal.text += format.substr(pos);
+            break;
+        }
+        if (!literal.text.empty())
+            segments.push_back(std::move(literal));
+        literal = Segment();
+
+        // {[index][:spec]}
+        auto field       = format.substr(pos + 1, end - pos - 1);
+        const auto colon = field.find(':');
+        auto id          = field.substr(0, colon);
+        auto spec = colon == std::string_view::npos ? std::string_view() : field.substr(colon + 1);
+
+        Segment segment;
+        segment.arg  = id.empty() ? next_arg++ : std::stoi(std::string(id));
+        segment.text = "{:" + std::string(spec) + "}";
+        parse_spec(segment, spec);
+        segments.push_back(std::move(segment));
+        pos = end;
+    }
+    if (!literal.text.empty())
+        segments.push_back(std::move(literal));
+}
+
+void CompiledFmt::parse_spec(Segment& segment, std::string_view spec) {
+    segment.plain = spec.empty();
+
+    // [[fill]>][0][width][d|x|X], anything else is left to fmt
+    size_t pos = 0;
+    if (spec.size() >= 2 && spec[1] == '>' && static_cast<unsigned char>(spec[0]) < 0x80) {
+        segment.fill = spec[0];
+        pos          = 2;
+    } else if (!spec.empty() && spec[0] == '>') {
+        pos = 1;
+    } else if (!spec.empty() && spec[0] == '0') {
+        segment.zeros = true;
+        pos           = 1;
+    }
+    for (; pos < spec.size() && std::isdigit(static_cast<unsigned char>(spec[pos])); ++pos)
+        segment.width = segment.width * 10 + (spec[pos] - '0');
+
+    if (pos + 1 == spec.size()) {
+        switch (spec[pos++]) {
+        case 'd':
+            break;
+        case 'x':
+            segment.base = 16;
+            break;
+        case 'X':
+            segment.base  = 16;
+            segment.upper = true;
+            break;
+        default:
+            return;
+        }
+    }
+    segment.direct = pos == spec.size();
+}
+
+void CompiledFmt::write_integer(
+    std::string& out, Segment const& segment, bool negative, uint64_t value) {
+    const char* digits = segment.upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char buffer[24];
+    auto end   = buffer + sizeof(buffer);
+    auto begin = end;
+    do {
+        *--begin = digits[value % segment.base];
+        value /= segment.base;
+    } while (value != 0);
+
+    const size_t size    = static_cast<size_t>(end - begin) + negative;
+    const size_t padding = segment.width > size ? segment.width - size : 0;
+    if (segment.zeros) {
+        if (negative)
+            out += '-';
+        out.append(padding, '0');
+    } else {
+        out.append(padding, segment.fill);
+        if (negative)
+            out += '-';
+    }
+    out.append(begin, end);
+}
+}
@@ -0,0 +1,63 @@
+#include "detfm/OpcodeFilter.hpp"
+#include <stdexcept>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace athes::detfm {
+OpcodeFilter::OpcodeFilter(uint32_t operands) : operands(operands, 0) { }
+
+void OpcodeFilter::add(OP opcode, uint32_t operand) {
+    auto byte = static_cast<uint8_t>(opcode);
+    if (slots[byte] == 0) {
+        if (opcodes.size() == max_opcodes)
+            throw std::length_error("Too many opcodes to filter.");
+
+        slots[byte] = static_cast<uint8_t>(1 << opcodes.size());
+        opcodes.push_back(byte);
+    }
+    if (operand < operands.size())
+        operands[operand] |= slots[byte];
+}
+
+bool OpcodeFilter::matches_at(std::vector<uint8_t> const& code, size_t pos) const {
+    const auto slot = slots[code[pos]];
+
+    // u30 operand, cut short at the end of the code
+    uint32_t operand = 0;
+    for (size_t i = 0; i < 5 && ++pos < code.size(); ++i) {
+        operand |= static_cast<uint32_t>(code[pos] & 0x7f) << (7 * i);
+        if (!(code[pos] & 0x80))
+            return operand < operands.size() && (operands[operand] & slot);
+    }
+    return false;
+}
+
+bool OpcodeFilter::matches(std::vector<uint8_t> const& code) const {
+    size_t pos = 0;
+#if defined(__SSE2__)
+    // Compare 16 bytes at once against each opcode, then check the candidates one by one
+    __m128i watched[max_opcodes];
+    for (size_t i = 0; i < opcodes.size(); ++i)
+        watched[i] = _mm_set1_epi8(static_cast<char>(opcodes[i]));
+
+    for (; pos + 16 <= code.size(); pos += 16) {
+        auto block      = _mm_loadu_si128(reinterpret_cast<__m128i const*>(code.data() + pos));
+        auto candidates = _mm_setzero_si128();
+        for (size_t i = 0; i < opcodes.size(); ++i)
+            candidates = _mm_or_si128(candidates, _mm_cmpeq_epi8(block, watched[i]));
+
+        for (auto mask = static_cast<uint32_t>(_mm_movemask_epi8(candidates)); mask != 0;
+             mask &= mask - 1) {
+            if (matches_at(code, pos + __builtin_ctz(mask)))
+                return true;
+        }
+    }
+#endif
+    for (; pos < code.size(); ++pos)
+        if (slots[code[pos]] != 0 && matches_at(code, pos))
+            return true;
+
+    return false;
+}
+}
@@ -0,0 +1,124 @@
+#include "detfm/PacketDatabase.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace athes::detfm {
+// See compile_packets.py for the layout
+constexpr std::string_view magic = { "DTFMPKT\0", 8 };
+constexpr uint32_t version       = 1;
+constexpr size_t header_size     = 16;
+constexpr size_t table_size      = 40;
+constexpr size_t name_size       = 32;
+constexpr size_t packet_size     = 8;
+
+static uint16_t read_u16(uint8_t const* ptr) { return uint16_t(ptr[0] | ptr[1] << 8); }
+static uint32_t read_u32(uint8_t const* ptr) {
+    return uint32_t(ptr[0]) | uint32_t(ptr[1]) << 8 | uint32_t(ptr[2]) << 16
+        | uint32_t(ptr[3]) << 24;
+}
+
+/* The table of the given name, nullptr for an unknown one */
+static pktnames::Table* find_table(PacketTables& tables, std::string_view name) {
+    if (name == "clientbound")
+        return &tables.clientbound;
+    if (name == "serverbound")
+        return &tables.serverbound;
+    if (name == "tribulle_clientbound")
+        return &tables.tribulle_clientbound;
+    if (name == "tribulle_serverbound")
+        return &tables.tribulle_serverbound;
+    return nullptr;
+}
+
+PacketDatabase::~PacketDatabase() { unmap(); }
+
+void PacketDatabase::unmap() {
+    if (data != nullptr)
+        munmap(const_cast<uint8_t*>(data), size);
+
+    data = nullptr;
+    size = 0;
+    loaded.clear();
+}
+
+std::optional<std::string> PacketDatabase::load(std::string const& path) {
+    unmap();
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return fmt::format("Unable to open {}: {}", path, std::strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < off_t(header_size)) {
+        close(fd);
+        return fmt::format("{} is not a packet database", path);
+    }
+
+    auto mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return fmt::format("Unable to map {}: {}", path, std::strerror(errno));
+
+    data = static_cast<uint8_t const*>(mapped);
+    size = size_t(st.st_size);
+
+    const auto error = [this, &path](std::string_view reason) {
+        unmap();
+        return fmt::format("Invalid packet database {}: {}", path, reason);
+    };
+    if (std::string_view(reinterpret_cast<char const*>(data), magic.size()) != magic)
+        return error("bad magic");
+    if (read_u32(data + 8) != version)
+        return error(fmt::format("unsupported version {}", read_u32(data + 8)));
+
+    const uint64_t count = read_u32(data + 12);
+    if (header_size + count * table_size > size)
+        return error("truncated tables");
+
+    // The names point into the mapping: only the entries are decoded, never the strings
+    PacketTables known;
+    loaded.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto table   = data + header_size + i * table_size;
+        auto name    = reinterpret_cast<char const*>(table);
+        auto packets = uint64_t(read_u32(table + name_size));
+        auto offset  = uint64_t(read_u32(table + name_size + 4));
+        if (offset + packets * packet_size > size)
+            return error("truncated packets");
+
+        loaded[i].name.assign(name, strnlen(name, name_size));
+        if (find_table(known, loaded[i].name) == nullptr)
+            return error(fmt::format("unknown table {}", loaded[i].name));
+
+        loaded[i].packets.reserve(packets);
+        for (size_t j = 0; j < packets; ++j) {
+            auto packet = data + offset + j * packet_size;
+            auto code   = read_u16(packet);
+            auto length = uint64_t(read_u16(packet + 2));
+            auto start  = uint64_t(read_u32(packet + 4));
+            if (start + length > size)
+                return error("truncated names");
+            if (j > 0 && code <= loaded[i].packets.back().code)
+                return error(fmt::format("packets of {} are not sorted", loaded[i].name));
+
+            loaded[i].packets.push_back(
+                { code, { reinterpret_cast<char const*>(data + start), length } });
+        }
+    }
+    return std::nullopt;
+}
+
+PacketTables PacketDatabase::tables() const {
+    // load() only keeps the known tables
+    PacketTables tables;
+    for (auto& table : loaded)
+        *find_table(tables, table.name) = { table.packets.data(), table.packets.size() };
+    return tables;
+}
+}
@@ -0,0 +1,271 @@
+#include "detfm/PoolCompactor.hpp"
+#include "detfm/code.hpp"
+#include <abc/parser/Parser.hpp>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace athes::detfm {
+using namespace swf::abc::parser;
+
+/* Pool referenced by a slot's or an optional parameter's value kind, if any */
+template <typename Pools>
+static auto value_pool(Pools& pools, uint8_t kind) -> decltype(&pools.strings) {
+    switch (kind) {
+    case 0x01:
+        return &pools.strings;
+    case 0x03:
+        return &pools.integers;
+    case 0x04:
+        return &pools.uintegers;
+    case 0x06:
+        return &pools.doubles;
+    default:
+        return nullptr;
+    }
+}
+
+/* Pool referenced by an instruction, and the index of the operand referencing it */
+template <typename Pools>
+static std::pair<decltype(&std::declval<Pools&>().strings), size_t>
+op_pool(Pools& pools, Instruction& ins) {
+    switch (ins.opcode) {
+    case OP::pushint:
+        return { &pools.integers, 0 };
+    case OP::pushuint:
+        return { &pools.uintegers, 0 };
+    case OP::pushdouble:
+        return { &pools.doubles, 0 };
+    case OP::pushstring:
+    case OP::debugfile:
+    case OP::dxns:
+        return { &pools.strings, 0 };
+    case OP::debug:
+        // debug_type, name, register, extra
+        return { &pools.strings, 1 };
+    default:
+        return { nullptr, 0 };
+    }
+}
+
+static void mark(std::vector<uint8_t>* used, uint32_t index) {
+    if (used != nullptr && index < used->size())
+        (*used)[index] = 1;
+}
+static void remap(std::vector<uint32_t> const* remap, uint32_t& index) {
+    if (remap != nullptr && index < remap->size())
+        index = (*remap)[index];
+}
+
+static bool has_value(abc::Trait& trait) {
+    return trait.kind == abc::TraitKind::Slot || trait.kind == abc::TraitKind::Const;
+}
+static bool has_name(abc::Multiname& mn) {
+    switch (mn.kind) {
+    case abc::MultinameKind::QName:
+    case abc::MultinameKind::QNameA:
+    case abc::MultinameKind::RTQName:
+    case abc::MultinameKind::RTQNameA:
+    case abc::MultinameKind::Multiname:
+    case abc::MultinameKind::MultinameA:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Keep the used values, merging the duplicates into their first occurrence.
+ * Index 0 is reserved and always kept. Return how many values were removed. */
+template <typename T, typename KeyFn>
+static size_t compact_values(
+    std::vector<T>& values, std::vector<uint8_t> const& used, std::vector<uint32_t>& remap,
+    KeyFn key_of) {
+    remap.assign(values.size(), 0);
+    if (values.empty())
+        return 0;
+
+    std::vector<T> kept;
+    // keys may point into the kept values, they must not move
+    kept.reserve(values.size());
+    kept.push_back(std::move(values[0]));
+
+    std::unordered_map<decltype(key_of(values[0])), uint32_t> index;
+    for (size_t i = 1; i < values.size(); ++i) {
+        if (!used[i])
+            continue;
+
+        auto it = index.find(key_of(values[i]));
+        if (it == index.end()) {
+            kept.push_back(std::move(values[i]));
+            it = index.emplace(key_of(kept.back()), static_cast<uint32_t>(kept.size() - 1)).first;
+        }
+        remap[i] = it->second;
+    }
+
+    const auto removed = values.size() - kept.size();
+    values             = std::move(kept);
+    return removed;
+}
+
+PoolCompactor::PoolCompactor(std::shared_ptr<abc::AbcFile> const& abc, ThreadPool& pool)
+    : abc(abc), pool(pool) { }
+
+PoolCompactor::Marks PoolCompactor::marks() const {
+    auto& cpool = abc->cpool;
+    Marks marks;
+    marks.integers.assign(cpool.integers.size(), 0);
+    marks.uintegers.assign(cpool.uintegers.size(), 0);
+    marks.doubles.assign(cpool.doubles.size(), 0);
+    marks.strings.assign(cpool.strings.size(), 0);
+    return marks;
+}
+
+void PoolCompactor::mark_code(Marks& marks, std::vector<uint8_t>& has_refs) {
+    auto& methods = abc->methods;
+    // each thread marks its own copy, merged afterward
+    std::vector<Marks> workers(pool.size(), marks);
+
+    pool.parallel_for(methods.size(), [&](WorkRange range) {
+        auto& local = workers[ThreadPool::worker()];
+        for (auto i = range.first; i < range.last; ++i) {
+            if (methods[i].code.empty())
+                continue;
+
+            Parser parser(methods[i]);
+            for (auto ins = parser.begin; ins; ins = ins->next) {
+                auto [used, arg] = op_pool(local, *ins);
+                if (used != nullptr && arg < ins->args.size()) {
+                    mark(used, ins->args[arg]);
+                    has_refs[i] = 1;
+                }
+            }
+        }
+    });
+
+    const auto merge = [](std::vector<uint8_t>& into, std::vector<uint8_t> const& from) {
+        for (size_t i = 0; i < into.size(); ++i)
+            into[i] |= from[i];
+    };
+    for (auto& local : workers) {
+        merge(marks.integers, local.integers);
+        merge(marks.uintegers, local.uintegers);
+        merge(marks.doubles, local.doubles);
+        merge(marks.strings, local.strings);
+    }
+}
+
+void PoolCompactor::mark_constants(Marks& marks) {
+    for (auto& mn : abc->cpool.multinames)
+        if (has_name(mn))
+            mark(&marks.strings, mn.get_name_index());
+
+    for (auto& ns : abc->cpool.namespaces)
+        mark(&marks.strings, ns.name);
+
+    for (auto& method : abc->methods) {
+        mark(&marks.strings, method.name);
+        for (auto& option : method.options)
+            mark(value_pool(marks, option.kind), option.value);
+    }
+    for (auto& metadata : abc->metadatas) {
+        mark(&marks.strings, metadata.name);
+        for (auto& [key, value] : metadata.items) {
+            mark(&marks.strings, key);
+            mark(&marks.strings, value);
+        }
+    }
+    for_each_trait(*abc, [&marks](abc::Trait& trait) {
+        if (has_value(trait))
+            mark(value_pool(marks, trait.slot.kind), trait.index);
+    });
+}
+
+void PoolCompactor::remap_constants(Remaps const& remaps) {
+    for (auto& mn : abc->cpool.multinames) {
+        if (has_name(mn)) {
+            auto name = mn.get_name_index();
+            remap(&remaps.strings, name);
+            mn.set_name_index(name);
+        }
+    }
+
+    for (auto& ns : abc->cpool.namespaces)
+        remap(&remaps.strings, ns.name);
+
+    for (auto& method : abc->methods) {
+        remap(&remaps.strings, method.name);
+        for (auto& option : method.options)
+            remap(value_pool(remaps, option.kind), option.value);
+    }
+    for (auto& metadata : abc->metadatas) {
+        remap(&remaps.strings, metadata.name);
+        for (auto& [key, value] : metadata.items) {
+            remap(&remaps.strings, key);
+            remap(&remaps.strings, value);
+        }
+    }
+    for_each_trait(*abc, [&remaps](abc::Trait& trait) {
+        if (has_value(trait))
+            remap(value_pool(remaps, trait.slot.kind), trait.index);
+    });
+}
+
+void PoolCompactor::remap_code(Remaps const& remaps, std::vector<uint8_t> const& has_refs) {
+    auto& methods = abc->methods;
+    pool.parallel_for(methods.size(), [&](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i) {
+            if (!has_refs[i])
+                continue;
+
+            Parser parser(methods[i]);
+            bool modified = false;
+            for (auto ins = parser.begin; ins; ins = ins->next) {
+                auto [indices, arg] = op_pool(remaps, *ins);
+                if (indices != nullptr && arg < ins->args.size()) {
+                    const auto prev = ins->args[arg];
+                    remap(indices, ins->args[arg]);
+                    modified |= ins->args[arg] != prev;
+                }
+            }
+
+            // The operands' size may have changed
+            if (modified)
+                write_code(methods[i], parser);
+        }
+    });
+}
+
+PoolCompactor::Stats PoolCompactor::compact() {
+    auto used = marks();
+    std::vector<uint8_t> has_refs(abc->methods.size(), 0);
+    mark_code(used, has_refs);
+    mark_constants(used);
+
+    const auto double_key = [](double value) {
+        // by bit pattern, to tell -0.0 and NaNs apart
+        uint64_t key;
+        std::memcpy(&key, &value, sizeof(key));
+        return key;
+    };
+    const auto identity = [](auto value) { return value; };
+
+    auto& cpool = abc->cpool;
+    Stats stats;
+    Remaps remaps;
+    stats.integers  = compact_values(cpool.integers, used.integers, remaps.integers, identity);
+    stats.uintegers = compact_values(cpool.uintegers, used.uintegers, remaps.uintegers, identity);
+    stats.doubles   = compact_values(cpool.doubles, used.doubles, remaps.doubles, double_key);
+    stats.strings   = compact_values(
+        cpool.strings, used.strings, remaps.strings, [](std::string const& value) {
+            return std::string_view(value);
+        });
+
+    if (stats.total() == 0)
+        return stats;
+
+    remap_constants(remaps);
+    remap_code(remaps, has_refs);
+    return stats;
+}
+}
@@ -0,0 +1,114 @@
+#include "detfm/PoolWriter.hpp"
+#include "detfm/ThreadPool.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace athes::detfm {
+static uint64_t double_key(double value) {
+    uint64_t key;
+    std::memcpy(&key, &value, sizeof(key));
+    return key;
+}
+
+/* Append the staged values to the pool in method order, skipping the ones already there */
+template <typename T, typename Key, typename KeyFn>
+void commit_values(
+    std::vector<T>& pool, std::unordered_map<Key, uint32_t>& index,
+    std::vector<std::pair<uint32_t, T>>& staged, std::vector<uint32_t>& methods, KeyFn key_of) {
+    std::stable_sort(staged.begin(), staged.end(), [](auto& a, auto& b) {
+        return a.first < b.first;
+    });
+
+    for (auto& [method, value] : staged) {
+        methods.push_back(method);
+        if (index.try_emplace(key_of(value), static_cast<uint32_t>(pool.size())).second)
+            pool.push_back(std::move(value));
+    }
+    staged.clear();
+}
+
+PoolWriter::PoolWriter(std::shared_ptr<abc::AbcFile> const& abc, size_t workers)
+    : abc(abc), buffers(std::max<size_t>(workers, 1)) { }
+
+PoolWriter::Buffer& PoolWriter::buffer() { return buffers[ThreadPool::worker() % buffers.size()]; }
+
+void PoolWriter::index_integers() {
+    std::call_once(integers_once, [this] {
+        auto& pool = abc->cpool.integers;
+        for (size_t i = 1; i < pool.size(); ++i)
+            integers.try_emplace(pool[i], static_cast<uint32_t>(i));
+    });
+}
+void PoolWriter::index_doubles() {
+    std::call_once(doubles_once, [this] {
+        auto& pool = abc->cpool.doubles;
+        for (size_t i = 1; i < pool.size(); ++i)
+            doubles.try_emplace(double_key(pool[i]), static_cast<uint32_t>(i));
+    });
+}
+void PoolWriter::index_strings() {
+    std::call_once(strings_once, [this] {
+        auto& pool = abc->cpool.strings;
+        for (size_t i = 1; i < pool.size(); ++i)
+            strings.try_emplace(pool[i], static_cast<uint32_t>(i));
+    });
+}
+
+std::optional<uint32_t> PoolWriter::add_integer(int32_t value, uint32_t method) {
+    index_integers();
+    auto it = integers.find(value);
+    if (it != integers.end())
+        return it->second;
+
+    buffer().integers.emplace_back(method, value);
+    return std::nullopt;
+}
+std::optional<uint32_t> PoolWriter::add_double(double value, uint32_t method) {
+    index_doubles();
+    auto it = doubles.find(double_key(value));
+    if (it != doubles.end())
+        return it->second;
+
+    buffer().doubles.emplace_back(method, value);
+    return std::nullopt;
+}
+std::optional<uint32_t> PoolWriter::add_string(std::string const& value, uint32_t method) {
+    index_strings();
+    auto it = strings.find(value);
+    if (it != strings.end())
+        return it->second;
+
+    buffer().strings.emplace_back(method, value);
+    return std::nullopt;
+}
+
+std::vector<uint32_t> PoolWriter::commit() {
+    // The indices must be up to date for the methods to be rewritten
+    index_integers();
+    index_doubles();
+    index_strings();
+
+    // Merge the threads' buffers: a method is handled by a single thread, so sorting them by
+    // method gives the same order whatever thread handled it
+    Buffer merged;
+    for (auto& buffer : buffers) {
+        merged.integers.insert(merged.integers.end(), buffer.integers.begin(), buffer.integers.end());
+        merged.doubles.insert(merged.doubles.end(), buffer.doubles.begin(), buffer.doubles.end());
+        merged.strings.insert(
+            merged.strings.end(),
+            std::make_move_iterator(buffer.strings.begin()),
+            std::make_move_iterator(buffer.strings.end()));
+        buffer = Buffer();
+    }
+
+    std::vector<uint32_t> methods;
+    auto& cpool = abc->cpool;
+    commit_values(cpool.integers, integers, merged.integers, methods, [](int32_t v) { return v; });
+    commit_values(cpool.doubles, doubles, merged.doubles, methods, double_key);
+    commit_values(cpool.strings, strings, merged.strings, methods, [](auto& v) { return v; });
+
+    std::sort(methods.begin(), methods.end());
+    methods.erase(std::unique(methods.begin(), methods.end()), methods.end());
+    return methods;
+}
+}
@@ -1,16 +1,29 @@
 #include "detfm/StaticClass.hpp"
+#include "detfm/CodeCache.hpp"
 #include "detfm/common.hpp"
 #include "detfm/eval.hpp"
+#include <algorithm>
 #include <fmt/core.h>
 #include <stdexcept>
 
 namespace athes::detfm {
+/* Value with the given name in a vector sorted by name, nullptr if there is none */
+template <typename T>
+static T const* find_sorted(std::vector<std::pair<uint32_t, T>> const& values, uint32_t name) {
+    auto it = std::lower_bound(values.begin(), values.end(), name, [](auto& value, uint32_t name) {
+        return value.first < name;
+    });
+    return it != values.end() && it->first == name ? &it->second : nullptr;
+}
+
 StaticClass::StaticClass() { }
-StaticClass::StaticClass(std::shared_ptr<abc::AbcFile>& abc, abc::Class& klass) : klass(&klass) {
+StaticClass::StaticClass(std::shared_ptr<abc::AbcFile>& abc, abc::Class& klass, CodeCache& code)
+    : klass(&klass) {
     std::unordered_map<uint32_t, abc::Trait*> notdefined;
+    std::vector<uint32_t> unknown;
     for (auto& trait : klass.ctraits) {
         if (trait.kind == abc::TraitKind::Slot) {
-            slots[trait.name] = &trait;
+            slots.emplace_back(trait.name, &trait);
             if (trait.slot.kind == 0x00)
                 notdefined[trait.name] = &trait;
         } else {
@@ -18,9 +31,9 @@ StaticClass::StaticClass(std::shared_ptr<abc::AbcFile>& abc, abc::Class& klass)
             auto return_type = abc->qname(method.return_type);
 
             if (return_type == "int")
-                methods[trait.name] = eval_method<int32_t>(abc, method);
+                methods.emplace_back(trait.name, eval_method<int32_t>(abc, code.get(trait.index)));
             else if (return_type == "Number")
-                methods[trait.name] = eval_method<double>(abc, method);
+                methods.emplace_back(trait.name, eval_method<double>(abc, code.get(trait.index)));
             else
                 throw std::runtime_error(fmt::format("Unknown return type: {}.", return_type));
         }
@@ -28,15 +41,13 @@ StaticClass::StaticClass(std::shared_ptr<abc::AbcFile>& abc, abc::Class& klass)
 
     // Evaluate the trait's value from the class init method
     if (!notdefined.empty()) {
-        Parser parser(abc->methods[klass.cinit]);
+        auto& cinit = code.get(klass.cinit);
 
-        auto ins = parser.begin;
-        while (ins) {
-            if (ins->opcode == OP::findproperty && ins->next) {
-                auto trait = notdefined.find(ins->args[0]);
+        for (uint32_t ins = 0; ins + 1 < cinit.size(); ++ins) {
+            if (cinit.op(ins) == OP::findproperty) {
+                auto trait = notdefined.find(cinit.arg(ins));
                 if (trait != notdefined.end()) {
-                    ins = ins->next;
-                    switch (ins->opcode) {
+                    switch (cinit.op(++ins)) {
                     case OP::pushfalse:
                         trait->second->slot.kind = 0x0A;
                         break;
@@ -44,25 +55,53 @@ StaticClass::StaticClass(std::shared_ptr<abc::AbcFile>& abc, abc::Class& klass)
                         trait->second->slot.kind = 0x0B;
                         break;
                     default:
-                        slots.erase(trait->first);
+                        unknown.push_back(trait->first);
                         break;
                     }
                     notdefined.erase(trait);
                 }
             }
-            ins = ins->next;
         }
     }
+
+    // Drop the slots whose value is unknown
+    const auto is_unknown = [&unknown](auto& slot) {
+        return std::find(unknown.begin(), unknown.end(), slot.first) != unknown.end();
+    };
+    slots.erase(std::remove_if(slots.begin(), slots.end(), is_unknown), slots.end());
+
+    const auto by_name = [](auto& a, auto& b) { return a.first < b.first; };
+    std::stable_sort(slots.begin(), slots.end(), by_name);
+    std::stable_sort(methods.begin(), methods.end(), by_name);
+}
+
+abc::Trait* StaticClass::slot(uint32_t name) const {
+    auto slot = find_sorted(slots, name);
+    return slot != nullptr ? *slot : nullptr;
 }
-bool StaticClass::is_slot(uint32_t index) { return slots.find(index) != slots.end(); }
-bool StaticClass::is_slot(std::shared_ptr<Instruction>& ins) {
+StaticClass::Value const* StaticClass::method(uint32_t name) const {
+    return find_sorted(methods, name);
+}
+
+bool StaticClass::is_slot(uint32_t index) const { return slot(index) != nullptr; }
+bool StaticClass::is_slot(std::shared_ptr<Instruction>& ins) const {
     return ins->opcode == OP::getproperty && is_slot(ins->args[0]);
 }
-bool StaticClass::is_method(uint32_t index) { return methods.find(index) != methods.end(); }
-bool StaticClass::is_method(std::shared_ptr<Instruction>& ins) {
+bool StaticClass::is_method(uint32_t index) const { return method(index) != nullptr; }
+bool StaticClass::is_method(std::shared_ptr<Instruction>& ins) const {
     return ins->opcode == OP::callproperty && is_method(ins->args[0]);
 }
 
+void StaticClasses::index(size_t multinames) {
+    lookup.assign(multinames, nullptr);
+    for (auto& [name, klass] : classes)
+        if (name < lookup.size())
+            lookup[name] = &klass;
+}
+
 StaticClass& StaticClasses::operator[](uint32_t index) { return classes[index]; }
-bool StaticClasses::is_static_class(uint32_t klass) { return classes.find(klass) != classes.end(); }
-}
\ No newline at end of file
+StaticClass* StaticClasses::find(uint32_t klass) const {
+    return klass < lookup.size() ? lookup[klass] : nullptr;
+}
+bool StaticClasses::is_static_class(uint32_t klass) const { return find(klass) != nullptr; }
+}
@@ -0,0 +1,31 @@
+#include "detfm/StringIndex.hpp"
+
+namespace athes::detfm {
+StringIndex::StringIndex(std::vector<std::string>& strings) : strings(strings) {
+    indices.reserve(strings.size());
+    for (uint32_t i = 0; i < strings.size(); ++i)
+        indices[strings[i]].push_back(i);
+}
+
+std::vector<uint32_t> const& StringIndex::find(std::string_view value) const {
+    static const std::vector<uint32_t> none;
+    auto it = indices.find(value);
+    return it != indices.end() ? it->second : none;
+}
+
+size_t StringIndex::replace(std::string_view from, std::string const& to) {
+    auto it = indices.find(from);
+    if (it == indices.end() || from == to)
+        return 0;
+
+    // The key points to the strings being replaced, take it out first
+    auto replaced = std::move(it->second);
+    indices.erase(it);
+    for (auto index : replaced)
+        strings[index] = to;
+
+    auto& target = indices[strings[replaced.front()]];
+    target.insert(target.end(), replaced.begin(), replaced.end());
+    return replaced.size();
+}
+}
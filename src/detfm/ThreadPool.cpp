@@ -0,0 +1,119 @@
+#include "detfm/ThreadPool.hpp"
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace athes::detfm {
+// Slot of the current thread in the work queues. Threads outside of the pool use the slot 0.
+static thread_local size_t current_worker = 0;
+
+ThreadPool::ThreadPool(uint32_t jobs) {
+    for (uint32_t i = 1; i < std::max<uint32_t>(jobs, 1); ++i)
+        threads.emplace_back(&ThreadPool::work, this, i);
+}
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mut);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& thread : threads)
+        thread.join();
+}
+
+size_t ThreadPool::size() const { return threads.size() + 1; }
+size_t ThreadPool::worker() { return current_worker; }
+
+WorkBalance ThreadPool::parallel_for(size_t count, RangeTask const& task, size_t grain) {
+    auto job = std::make_shared<Job>(size());
+    job->queue.split(count, grain);
+    job->run = [&task](WorkRange range) {
+        task(range);
+        return static_cast<uint64_t>(range.last - range.first);
+    };
+    return submit(std::move(job), count);
+}
+WorkBalance ThreadPool::parallel_for(std::vector<uint64_t> const& costs, IndexTask const& task) {
+    auto job = std::make_shared<Job>(size());
+    job->queue.schedule(costs);
+    job->run = [&task, &costs, queue = &job->queue](WorkRange range) {
+        uint64_t cost = 0;
+        for (auto i = range.first; i < range.last; ++i) {
+            const auto index = queue->index(i);
+            cost += costs[index];
+            task(index);
+        }
+        return cost;
+    };
+    return submit(std::move(job), costs.size());
+}
+
+WorkBalance ThreadPool::submit(std::shared_ptr<Job> job, size_t count) {
+    job->remaining = count;
+    if (count == 0)
+        return job->queue.balance();
+
+    if (!threads.empty()) {
+        {
+            std::lock_guard<std::mutex> guard(mut);
+            jobs.push_back(job);
+        }
+        available.notify_all();
+    }
+
+    help(*job, current_worker);
+    retire(job);
+
+    std::unique_lock<std::mutex> lock(job->mut);
+    job->done.wait(lock, [&job] { return job->remaining == 0; });
+    if (job->error)
+        std::rethrow_exception(job->error);
+
+    return job->queue.balance();
+}
+
+void ThreadPool::work(size_t worker) {
+    current_worker = worker;
+
+    std::unique_lock<std::mutex> lock(mut);
+    while (true) {
+        available.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping)
+            return;
+
+        auto job = jobs.front();
+        lock.unlock();
+        help(*job, worker);
+        // Nothing left to hand out, the last ranges are being processed by other threads
+        retire(job);
+        lock.lock();
+    }
+}
+
+void ThreadPool::help(Job& job, size_t worker) {
+    WorkRange range;
+    while (job.queue.pop(worker, range)) {
+        // Don't bother running the remaining ranges once an error occurred
+        if (!job.failed) {
+            try {
+                job.queue.done(worker, job.run(range));
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(job.mut);
+                if (!job.failed.exchange(true))
+                    job.error = std::current_exception();
+            }
+        }
+
+        const auto size = range.last - range.first;
+        if (job.remaining.fetch_sub(size) == size) {
+            std::lock_guard<std::mutex> guard(job.mut);
+            job.done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::retire(std::shared_ptr<Job> const& job) {
+    std::lock_guard<std::mutex> guard(mut);
+    jobs.remove(job);
+}
+}
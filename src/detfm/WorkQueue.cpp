@@ -0,0 +1,116 @@
+#include "detfm/WorkQueue.hpp"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <utility>
+
+namespace athes::detfm {
+// How many chunks each worker gets on average when the grain is picked automatically
+constexpr size_t chunks_per_worker = 16;
+
+double WorkBalance::efficiency() const {
+    if (busiest == 0 || workers == 0)
+        return 1.0;
+
+    return static_cast<double>(total) / static_cast<double>(busiest * workers);
+}
+
+WorkQueue::WorkQueue(size_t workers) {
+    for (size_t i = 0; i < std::max<size_t>(workers, 1); ++i)
+        slots.push_back(std::make_unique<Slot>());
+}
+
+size_t WorkQueue::workers() const { return slots.size(); }
+
+void WorkQueue::split(size_t count, size_t grain) {
+    if (grain == 0)
+        grain = std::max<size_t>(count / (slots.size() * chunks_per_worker), 1);
+
+    const auto chunks    = (count + grain - 1) / grain;
+    const auto per_slot  = chunks / slots.size();
+    const auto remainder = chunks % slots.size();
+
+    size_t first = 0;
+    for (size_t worker = 0; worker < slots.size(); ++worker) {
+        const auto slot_chunks = per_slot + (worker < remainder ? 1 : 0);
+        for (size_t i = 0; i < slot_chunks; ++i) {
+            const auto last = std::min(first + grain, count);
+            push(worker, { first, last });
+            first = last;
+        }
+    }
+}
+
+void WorkQueue::schedule(std::vector<uint64_t> const& costs) {
+    order.resize(costs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+        return costs[a] > costs[b];
+    });
+
+    // min-heap of (planned load, worker)
+    using Load = std::pair<uint64_t, size_t>;
+    std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+    for (size_t worker = 0; worker < slots.size(); ++worker)
+        loads.emplace(0, worker);
+
+    for (size_t position = 0; position < order.size(); ++position) {
+        auto [load, worker] = loads.top();
+        loads.pop();
+
+        push(worker, { position, position + 1 });
+        // Count empty methods too, so they are not all dealt to the same worker
+        loads.emplace(load + std::max<uint64_t>(costs[order[position]], 1), worker);
+    }
+}
+
+void WorkQueue::push(size_t worker, WorkRange range) {
+    auto& slot = *slots[worker % slots.size()];
+    std::lock_guard<std::mutex> guard(slot.mut);
+    slot.ranges.push_back(range);
+}
+
+bool WorkQueue::pop(size_t worker, WorkRange& range) {
+    auto& slot = *slots[worker % slots.size()];
+    {
+        std::lock_guard<std::mutex> guard(slot.mut);
+        if (!slot.ranges.empty()) {
+            range = slot.ranges.front();
+            slot.ranges.pop_front();
+            return true;
+        }
+    }
+    return steal(worker, range);
+}
+
+bool WorkQueue::is_identity() const { return order.empty(); }
+size_t WorkQueue::index(size_t position) const {
+    return order.empty() ? position : order[position];
+}
+
+void WorkQueue::done(size_t worker, uint64_t cost) { slots[worker % slots.size()]->load += cost; }
+WorkBalance WorkQueue::balance() const {
+    WorkBalance balance;
+    balance.workers = slots.size();
+    for (auto& slot : slots) {
+        balance.total += slot->load;
+        balance.busiest = std::max(balance.busiest, slot->load);
+    }
+    return balance;
+}
+
+bool WorkQueue::steal(size_t worker, WorkRange& range) {
+    // Start with the next worker, so the thieves don't all target the same victim
+    for (size_t i = 1; i < slots.size(); ++i) {
+        auto& victim = *slots[(worker + i) % slots.size()];
+        std::lock_guard<std::mutex> guard(victim.mut);
+        if (!victim.ranges.empty()) {
+            range = victim.ranges.back();
+            victim.ranges.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+}
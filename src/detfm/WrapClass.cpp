@@ -3,16 +3,20 @@
 namespace athes::detfm {
 using abc::parser::OP;
 
-WrapClass::WrapClass(abc::Class& klass) : klass(&klass) {
-    for (auto& trait : klass.ctraits)
-        methods.insert(trait.name);
+WrapClass::WrapClass(abc::Class& klass, size_t multinames)
+    : klass(&klass), wraps(multinames, 0) {
+    for (auto& trait : klass.ctraits) {
+        methods.push_back(trait.name);
+        if (trait.name < wraps.size())
+            wraps[trait.name] = 1;
+    }
 }
 
 uint32_t WrapClass::name() { return klass->name; }
 
-bool WrapClass::is_wrap(uint32_t method) { return methods.find(method) != methods.end(); }
+bool WrapClass::is_wrap(uint32_t method) const { return method < wraps.size() && wraps[method]; }
 
-bool WrapClass::is_wrap(std::shared_ptr<Instruction>& ins) {
+bool WrapClass::is_wrap(std::shared_ptr<Instruction>& ins) const {
     if (ins->opcode == OP::callproperty || ins->opcode == OP::getproperty)
         return is_wrap(ins->args[0]);
     return false;
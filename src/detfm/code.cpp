@@ -0,0 +1,13 @@
+#include "detfm/code.hpp"
+#include "detfm/Arena.hpp"
+#include "detfm/opinfo.hpp"
+
+namespace athes::detfm {
+using namespace swf::abc::parser;
+namespace abc = swf::abc;
+
+void write_code(abc::Method& method, Parser& parser) {
+    Arena::Scope arena;
+    OpRegister(parser, method, arena.resource()).write(method);
+}
+}
@@ -1,8 +1,7 @@
 #include "detfm/eval.hpp"
+#include "detfm/Bytecode.hpp"
 #include <abc/AbcFile.hpp>
 #include <abc/info/ConstantPool.hpp>
-#include <abc/parser/Instruction.hpp>
-#include <abc/parser/Parser.hpp>
 #include <abc/parser/opcodes.hpp>
 #include <memory>
 #include <stack>
@@ -29,24 +28,22 @@ template <typename T> T divise(std::stack<T>& stack) {
     auto& b = pop(stack);
     return a / b;
 }
-template <typename T> T eval_method(std::shared_ptr<abc::AbcFile>& abc, abc::Method& method) {
-    Parser parser(method);
+template <typename T> T eval_method(std::shared_ptr<abc::AbcFile>& abc, Bytecode const& code) {
     std::stack<T> stack;
 
-    auto ins = parser.begin;
-    while (ins) {
-        switch (ins->opcode) {
+    for (uint32_t ins = 0; ins < code.size(); ++ins) {
+        switch (code.op(ins)) {
         case OP::getlocal0:
         case OP::pushscope:
             break;
         case OP::pushbyte:
-            stack.push(static_cast<T>(static_cast<uint8_t>(ins->args[0])));
+            stack.push(static_cast<T>(static_cast<uint8_t>(code.arg(ins))));
             break;
         case OP::pushshort:
-            stack.push(static_cast<T>(static_cast<int32_t>(ins->args[0])));
+            stack.push(static_cast<T>(static_cast<int32_t>(code.arg(ins))));
             break;
         case OP::pushint:
-            stack.push(static_cast<T>(abc->cpool.integers[ins->args[0]]));
+            stack.push(static_cast<T>(abc->cpool.integers[code.arg(ins)]));
             break;
         case OP::add:
             stack.push(add(stack));
@@ -60,12 +57,11 @@ template <typename T> T eval_method(std::shared_ptr<abc::AbcFile>& abc, abc::Met
             throw std::runtime_error("Unsupported operation.");
             break;
         }
-        ins = ins->next;
     }
 
     throw std::runtime_error("Nothing to return.");
 }
 
-template int eval_method<int>(std::shared_ptr<abc::AbcFile>& abc, abc::Method& method);
-template double eval_method<double>(std::shared_ptr<abc::AbcFile>& abc, abc::Method& method);
+template int eval_method<int>(std::shared_ptr<abc::AbcFile>& abc, Bytecode const& code);
+template double eval_method<double>(std::shared_ptr<abc::AbcFile>& abc, Bytecode const& code);
 }
\ No newline at end of file
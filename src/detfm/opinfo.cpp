@@ -3,35 +3,54 @@
 #include <abc/parser/Parser.hpp>
 
 namespace athes::detfm {
-OpInfo::OpInfo(std::shared_ptr<Instruction> ins) : addr(ins->addr), ins(ins) { }
+template <typename Node>
+void OpRegister::append(std::pmr::vector<Node>& nodes, EdgeList& list, Node node) {
+    nodes.push_back(node);
+    const auto index = static_cast<uint32_t>(nodes.size());
+    if (list.tail != 0)
+        nodes[list.tail - 1].next = index;
+    else
+        list.head = index;
+    list.tail = index;
+}
+template <typename Node>
+void OpRegister::splice(std::pmr::vector<Node>& nodes, EdgeList& into, EdgeList& list) {
+    if (list.head == 0)
+        return;
+    if (into.tail != 0)
+        nodes[into.tail - 1].next = list.head;
+    else
+        into.head = list.head;
+    into.tail = list.tail;
+}
+
+OpInfo::OpInfo(std::shared_ptr<Instruction> ins, std::pmr::memory_resource* memory)
+    : addr(ins->addr), ins(ins), jumpsTo(memory) { }
 bool OpInfo::removed() { return ins->next == nullptr; }
 void OpInfo::remove(Parser& parser, OpRegister& reg) {
     if (removed())
         return;
 
-    for (auto& opinfo : jumpsHere) {
-        for (size_t i = 0; i < opinfo->jumpsTo.size(); ++i) {
-            if (opinfo->jumpsTo[i].get() == this) {
-                opinfo->jumpsTo[i] = next;
-                break;
-            }
-        }
+    for (auto i = jumpsHere.head; i != 0; i = reg.jumps[i - 1].next) {
+        auto& jump                   = reg.jumps[i - 1];
+        jump.from->jumpsTo[jump.arg] = next;
+    }
+    for (auto i = errors.head; i != 0; i = reg.error_refs[i - 1].next) {
+        auto& ref = reg.error_refs[i - 1];
+        ref.err->replace(next, ref.field);
     }
 
-    for (auto& err : errors)
-        err.second->replace(next, err.first);
-
-    next->errors.merge(errors);
-    errors.clear();
-
-    next->jumpsHere.merge(jumpsHere);
-    jumpsHere.clear();
+    // Hand the whole lists over, their nodes stay where they are
+    OpRegister::splice(reg.jumps, next->jumpsHere, jumpsHere);
+    OpRegister::splice(reg.error_refs, next->errors, errors);
+    jumpsHere = {};
+    errors    = {};
 
     ins->next->prev = ins->prev;
     auto prev       = ins->prev.lock();
     if (prev) {
-        prev->next            = ins->next;
-        reg[prev->addr]->next = next;
+        prev->next      = ins->next;
+        reg[prev]->next = next;
     }
 
     // if the first instruction is removed, then parser.begin is not valid anymore
@@ -45,15 +64,18 @@ void OpInfo::remove(Parser& parser, OpRegister& reg) {
 }
 
 ErrorInfo::ErrorInfo(abc::Exception& err, OpRegister& reg) : err(err) {
-    from   = reg[err.from];
-    to     = reg[err.to];
-    target = reg[err.target];
+    from   = reg.at(err.from);
+    to     = reg.at(err.to);
+    target = reg.at(err.target);
 
-    from->errors.insert({ ErrorField::from, this });
-    to->errors.insert({ ErrorField::to, this });
-    target->errors.insert({ ErrorField::target, this });
+    // to may be the end of the code
+    for (auto [field, opinfo] : { std::pair { ErrorField::from, from },
+                                  std::pair { ErrorField::to, to },
+                                  std::pair { ErrorField::target, target } })
+        if (opinfo != nullptr)
+            OpRegister::append(reg.error_refs, opinfo->errors, { field, this, 0 });
 }
-void ErrorInfo::replace(std::shared_ptr<OpInfo>& opinfo, const ErrorField& field) {
+void ErrorInfo::replace(OpInfo* opinfo, const ErrorField& field) {
     switch (field) {
     case ErrorField::from:
         from = opinfo;
@@ -66,4 +88,94 @@ void ErrorInfo::replace(std::shared_ptr<OpInfo>& opinfo, const ErrorField& field
         break;
     }
 }
-}
\ No newline at end of file
+
+OpRegister::OpRegister(Parser& parser, abc::Method& method, std::pmr::memory_resource* memory)
+    : parser(parser), code_size(static_cast<uint32_t>(method.code.size())), ops(memory),
+      ordinals(memory), exceptions(memory), jumps(memory), error_refs(memory) {
+    size_t count = 0, edges = 0;
+    for (auto ins = parser.begin; ins; ins = ins->next) {
+        ++count;
+        if (ins->isJump())
+            edges += ins->args.size();
+    }
+
+    // reserved once: the OpInfo must never move
+    ops.reserve(count);
+    jumps.reserve(edges);
+    error_refs.reserve(3 * method.exceptions.size());
+    ordinals.assign(code_size + 1, 0);
+    for (auto ins = parser.begin; ins; ins = ins->next) {
+        ops.emplace_back(ins, memory);
+        if (ins->addr < ordinals.size())
+            ordinals[ins->addr] = static_cast<uint32_t>(ops.size());
+    }
+    for (size_t i = 1; i < ops.size(); ++i)
+        ops[i - 1].next = &ops[i];
+
+    for (auto& opinfo : ops) {
+        if (!opinfo.ins->isJump())
+            continue;
+
+        for (uint32_t offset : opinfo.ins->args) {
+            auto target = at(offset);
+
+            // Invalid jump; jump to next instruction instead, or to the end of the code
+            if (target == nullptr)
+                target = opinfo.next;
+
+            const auto arg = static_cast<uint32_t>(opinfo.jumpsTo.size());
+            opinfo.jumpsTo.push_back(target);
+            if (target != nullptr)
+                append(jumps, target->jumpsHere, { &opinfo, arg, 0 });
+        }
+    }
+
+    exceptions.reserve(method.exceptions.size());
+    for (auto& err : method.exceptions)
+        exceptions.emplace_back(err, *this);
+}
+
+OpInfo* OpRegister::at(uint32_t addr) {
+    if (addr >= ordinals.size() || ordinals[addr] == 0)
+        return nullptr;
+    return &ops[ordinals[addr] - 1];
+}
+
+void OpRegister::write(abc::Method& method) {
+    uint32_t pos = 0;
+
+    // re-compute the instructions position
+    for (auto ins = parser.begin; ins; ins = ins->next) {
+        auto opinfo  = at(ins->addr);
+        opinfo->addr = pos;
+        pos += ins->size();
+    }
+
+    for (auto ins = parser.begin; ins; ins = ins->next) {
+        auto opinfo = at(ins->addr);
+
+        // A null target is the end of the code
+        if (ins->isJump())
+            for (size_t i = 0; i < ins->args.size(); ++i)
+                ins->args[i] = opinfo->jumpsTo[i] != nullptr ? opinfo->jumpsTo[i]->addr : pos;
+    }
+
+    swf::StreamWriter stream;
+    for (auto ins = parser.begin; ins; ins = ins->next)
+        ins->write(stream);
+
+    method.code.clear();
+    method.code.insert(method.code.end(), stream.get_buffer(), stream.get_buffer() + stream.size());
+
+    // Addresses outside of the code (the end) stay after the last instruction
+    const auto addr_of = [this, pos](OpInfo* opinfo, uint32_t addr) {
+        return opinfo != nullptr ? opinfo->addr : (addr >= code_size ? pos : addr);
+    };
+    for (size_t i = 0; i < method.exceptions.size(); ++i) {
+        auto& err                   = exceptions[i];
+        method.exceptions[i].from   = addr_of(err.from, err.err.from);
+        method.exceptions[i].to     = addr_of(err.to, err.err.to);
+        method.exceptions[i].target = addr_of(err.target, err.err.target);
+    }
+}
+}
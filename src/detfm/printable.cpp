@@ -0,0 +1,36 @@
+#include "detfm/printable.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace athes::detfm {
+static bool printable_char(char c) { return c >= 0x20 && c <= 0x7e; }
+
+bool is_printable(std::string_view value) {
+    size_t pos = 0;
+#if defined(__SSE2__)
+    // As signed bytes, the printable characters are the ones in ]0x1f, 0x7f[
+    const auto low  = _mm_set1_epi8(0x1f);
+    const auto high = _mm_set1_epi8(0x7f);
+    for (; pos + 16 <= value.size(); pos += 16) {
+        auto block     = _mm_loadu_si128(reinterpret_cast<__m128i const*>(value.data() + pos));
+        auto printable = _mm_and_si128(_mm_cmpgt_epi8(block, low), _mm_cmplt_epi8(block, high));
+        if (_mm_movemask_epi8(printable) != 0xffff)
+            return false;
+    }
+#endif
+    for (; pos < value.size(); ++pos)
+        if (!printable_char(value[pos]))
+            return false;
+
+    return true;
+}
+
+std::vector<uint8_t> unprintable_strings(std::vector<std::string> const& strings) {
+    std::vector<uint8_t> flags(strings.size(), 0);
+    for (size_t i = 0; i < strings.size(); ++i)
+        flags[i] = !is_printable(strings[i]);
+
+    return flags;
+}
+}
@@ -1,12 +1,16 @@
 #include "detfm/simplify.hpp"
+#include "detfm/Arena.hpp"
 #include "detfm/common.hpp"
+#include "detfm/PoolWriter.hpp"
 #include "detfm/opinfo.hpp"
 #include <abc/AbcFile.hpp>
 #include <abc/parser/Parser.hpp>
 #include <array>
 #include <cmath>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <memory_resource>
 #include <optional>
 #include <stack>
 #include <stdexcept>
@@ -20,6 +24,7 @@ using namespace abc::parser;
 
 using StackValue = std::variant<std::monostate, bool, double, std::string>;
 using Operation  = std::function<StackValue(const StackValue&, const StackValue&)>;
+using ValueStack = std::stack<StackValue, std::pmr::deque<StackValue>>;
 
 std::vector<std::unordered_map<OP, Operation>> operations
     = { {}, // monostate
@@ -87,38 +92,40 @@ std::unordered_map<OP, uint32_t> dynamic_stack_op = {
     { OP::callpropvoid, 1 },
 };
 
-template <typename T> T pop_value(std::stack<T>& stack) {
+template <typename Stack> typename Stack::value_type pop_value(Stack& stack) {
     auto v = std::move(stack.top());
     stack.pop();
     return v;
 }
 
-void edit_ins(
-    std::shared_ptr<abc::AbcFile>& abc, Parser& parser, OpRegister& insreg,
-    std::stack<StackValue> stack, std::shared_ptr<OpInfo>& opinfo, uint32_t ins2remove) {
+/* Replace the expression with its value. Return false if the value had to be staged. */
+bool edit_ins(
+    PoolWriter& writer, uint32_t method, Parser& parser, OpRegister& insreg,
+    ValueStack const& stack, OpInfo* opinfo, uint32_t ins2remove) {
     for (uint32_t i = 0; i < ins2remove; ++i)
-        insreg[opinfo->ins->prev.lock()->addr]->remove(parser, insreg);
+        insreg[opinfo->ins->prev.lock()]->remove(parser, insreg);
 
     if (std::holds_alternative<double>(stack.top())) {
         const auto& value = std::get<double>(stack.top());
         if (std::fmod(value, 1) != 0 || std::abs(value) > 0x8000) {
-            uint32_t index = abc->cpool.doubles.size();
-            abc->cpool.doubles.push_back(value);
+            auto index          = writer.add_double(value, method);
             opinfo->ins->opcode = OP::pushdouble;
-            opinfo->ins->args   = { index };
+            opinfo->ins->args   = { index.value_or(0) };
+            return index.has_value();
         } else {
             opinfo->ins->opcode = std::abs(value) > 0x80 ? OP::pushshort : OP::pushbyte;
             opinfo->ins->args   = { static_cast<uint32_t>(value) };
         }
     } else if (std::holds_alternative<std::string>(stack.top())) {
-        uint32_t index = abc->cpool.strings.size();
-        abc->cpool.strings.push_back(std::get<std::string>(stack.top()));
+        auto index          = writer.add_string(std::get<std::string>(stack.top()), method);
         opinfo->ins->opcode = OP::pushstring;
-        opinfo->ins->args   = { index };
+        opinfo->ins->args   = { index.value_or(0) };
+        return index.has_value();
     } else if (std::holds_alternative<bool>(stack.top())) {
         opinfo->ins->opcode = std::get<bool>(stack.top()) ? OP::pushtrue : OP::pushfalse;
         opinfo->ins->args   = {};
     }
+    return true;
 }
 
 bool eval_bool(StackValue value) {
@@ -134,45 +141,19 @@ bool eval_bool(StackValue value) {
     return false;
 }
 
-void simplify_expressions(std::shared_ptr<abc::AbcFile>& abc, abc::Method& method) {
+bool simplify_expressions(
+    std::shared_ptr<abc::AbcFile>& abc, abc::Method& method, PoolWriter& writer) {
+    const auto index = static_cast<uint32_t>(&method - abc->methods.data());
     Parser parser(method);
-    std::stack<StackValue> stack;
-    std::vector<ErrorInfo> exceptions;
-
-    OpRegister insreg;
-    // populate the instruction register
-    auto ins  = parser.begin;
-    auto prev = insreg[ins->addr] = std::make_shared<OpInfo>(ins);
-    while ((ins = ins->next) != nullptr) {
-        insreg[ins->addr] = std::make_shared<OpInfo>(ins);
-        prev = prev->next = insreg[ins->addr];
-    }
-    ins = parser.begin;
-    while (ins) {
-        auto opinfo = insreg[ins->addr];
-
-        if (ins->isJump()) {
-            for (uint32_t offset : ins->args) {
-                auto it = insreg.find(offset);
-
-                // Invalid jump; jump to next instruction instead
-                if (it == insreg.end())
-                    offset = ins->next->addr;
-
-                auto target = insreg[offset];
-                opinfo->jumpsTo.push_back(target);
-                target->jumpsHere.insert(opinfo.get());
-            }
-        }
-        ins = ins->next;
-    }
-    ins = parser.begin;
-    for (auto& err : method.exceptions)
-        exceptions.emplace_back(err, insreg);
+    Arena::Scope arena;
+    ValueStack stack(std::pmr::deque<StackValue>(arena.resource()));
+    OpRegister insreg(parser, method, arena.resource());
+    auto ins = parser.begin;
 
     bool modified = false;
+    bool complete = true;
     while (ins) {
-        auto opinfo = insreg[ins->addr];
+        auto opinfo = insreg[ins];
         switch (ins->opcode) {
         case OP::pushbyte:
             stack.push(static_cast<double>(static_cast<int8_t>(ins->args[0])));
@@ -229,14 +210,14 @@ void simplify_expressions(std::shared_ptr<abc::AbcFile>& abc, abc::Method& metho
             }
             modified = true;
             stack.push(ops.at(ins->opcode)(a, b));
-            edit_ins(abc, parser, insreg, stack, opinfo, 2);
+            complete &= edit_ins(writer, index, parser, insreg, stack, opinfo, 2);
             break;
         }
         case OP::negate: {
             if (std::holds_alternative<double>(stack.top())) {
                 modified    = true;
                 stack.top() = -std::get<double>(stack.top());
-                edit_ins(abc, parser, insreg, stack, opinfo, 1);
+                complete &= edit_ins(writer, index, parser, insreg, stack, opinfo, 1);
             }
             break;
         }
@@ -244,7 +225,7 @@ void simplify_expressions(std::shared_ptr<abc::AbcFile>& abc, abc::Method& metho
             if (ins->args[1] == 1 && abc->str(ins->args[0]) == "Boolean") {
                 modified    = true;
                 stack.top() = eval_bool(stack.top());
-                edit_ins(abc, parser, insreg, stack, opinfo, 2);
+                complete &= edit_ins(writer, index, parser, insreg, stack, opinfo, 2);
                 break;
             }
             /* fallthrough */
@@ -272,44 +253,13 @@ void simplify_expressions(std::shared_ptr<abc::AbcFile>& abc, abc::Method& metho
         ins = ins->next;
     }
 
-    if (modified) {
-        uint32_t pos = 0;
+    // Some values are not in the constant pool yet
+    if (!complete)
+        return false;
 
-        // re-compute the instructions position
-        ins = parser.begin;
-        while (ins) {
-            auto opinfo  = insreg[ins->addr];
-            opinfo->addr = pos;
-            pos += ins->size();
-            ins = ins->next;
-        }
-
-        ins = parser.begin;
-        while (ins) {
-            auto opinfo = insreg[ins->addr];
-
-            if (ins->isJump())
-                for (size_t i = 0; i < ins->args.size(); ++i)
-                    ins->args[i] = opinfo->jumpsTo[i]->addr;
-
-            ins = ins->next;
-        }
+    if (modified)
+        insreg.write(method);
 
-        swf::StreamWriter stream;
-        ins = parser.begin;
-        while (ins) {
-            ins->write(stream);
-            ins = ins->next;
-        }
-        method.code.clear();
-        method.code.insert(
-            method.code.end(), stream.get_buffer(), stream.get_buffer() + stream.size());
-
-        for (size_t i = 0; i < method.exceptions.size(); ++i) {
-            method.exceptions[i].from   = exceptions[i].from->addr;
-            method.exceptions[i].to     = exceptions[i].to->addr;
-            method.exceptions[i].target = exceptions[i].target->addr;
-        }
-    }
+    return true;
 }
 }
\ No newline at end of file
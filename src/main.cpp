@@ -1,33 +1,28 @@
+#include "batch.hpp"
 #include "detfm.hpp"
+#include "detfm/PacketDatabase.hpp"
+#include "detfm/ThreadPool.hpp"
 #include "detfm/common.hpp"
 #include "fmt_swf.hpp"
-#include "match/ClassMatcher.hpp"
-#include "match/MatchResult.hpp"
-#include "renamer.hpp"
+#include "pipeline.hpp"
+#include "server.hpp"
 #include "utils.hpp"
-#include <abc/AbcFile.hpp>
 #include <abc/parser/Parser.hpp>
 #include <algorithm>
 #include <argparse/argparse.hpp>
 #include <array>
 #include <cstdint>
-#include <deque>
-#include <filesystem>
 #include <fmt/format.h>
 #include <fmt/ranges.h>
-#include <fmt/std.h>
 #include <fstream>
 #include <functional>
-#include <list>
 #include <map>
 #include <memory>
-#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <swf/swf.hpp>
 #include <thread>
 #include <unordered_map>
-#include <unpacker.hpp>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -35,9 +30,7 @@
 using namespace swf::abc::parser;
 using namespace athes::detfm;
 using namespace fmt::literals;
-using athes::unpack::Unpacker;
 namespace arg   = argparse;
-namespace fs    = std::filesystem;
 namespace utils = athes::utils;
 
 static utils::Logger logger;
@@ -48,42 +41,8 @@ uint32_t get_jobs(const uint32_t jobs) {
     return jobs;
 }
 
-void task(detfm& detfm, std::shared_ptr<abc::AbcFile>& abc, std::deque<abc::Method*>& indexes) {
-    static std::mutex mut;
-    abc::Method* method = nullptr;
-    while (true) {
-        {
-            std::lock_guard<std::mutex> guard(mut);
-            if (indexes.empty())
-                break;
-
-            method = indexes.back();
-            indexes.pop_back();
-        }
-        detfm.unscramble(*method);
-    }
-}
-
-void unscramble(detfm& detfm, std::shared_ptr<abc::AbcFile>& abc, uint32_t jobs) {
-    if (jobs == 1)
-        return detfm.unscramble();
-
-    std::deque<abc::Method*> indexes;
-    const auto length = abc->methods.size();
-    for (uint32_t i = 0; i < length; ++i)
-        indexes.push_back(&abc->methods[i]);
-
-    logger.info("Spawning {} threads.\n", jobs);
-    std::vector<std::thread> threads;
-    for (uint32_t i = 0; i < jobs; ++i)
-        threads.emplace_back(task, std::ref(detfm), std::ref(abc), std::ref(indexes));
-
-    for (auto& th : threads)
-        th.join();
-}
-
 auto arg_choices(std::vector<std::string> choices, std::string error_message = "Invalid choice.") {
-    return [&](const std::string& value) {
+    return [choices, error_message](const std::string& value) {
         std::string lower;
         for (auto& c : value)
             lower.push_back(std::tolower(c));
@@ -122,6 +81,11 @@ int main(int argc, char const* argv[]) {
               "auto-detect the number of processors available to use.")
         .default_value<uint32_t>(0)
         .scan<'u', uint32_t>();
+    program.add_argument("--schedule")
+        .help("How to distribute the methods between threads. Possible values: lpt (biggest "
+              "methods first), chunked (contiguous chunks of methods).")
+        .default_value(std::string("lpt"))
+        .action(arg_choices({ "lpt", "chunked" }, "Invalid scheduling mode."));
     program.add_argument("-d", "--classdef")
         .help("Path to a folder containing classes definition (.yaml files).");
     program.add_argument("-c", "--config")
@@ -130,6 +94,9 @@ int main(int argc, char const* argv[]) {
     program.add_argument("--dump-config")
         .help("Dump the default config file to the specified file.")
         .default_value(std::string(""));
+    program.add_argument("--packets")
+        .help("Path to a packet database, written by `compile_packets.py --binary`, to use instead "
+              "of the packet names built into the executable.");
     program.add_argument("--ignore-missing")
         .help("Ignore missing classes and proceed anyway. It will likely crash.")
         .default_value(false)
@@ -138,6 +105,14 @@ int main(int argc, char const* argv[]) {
         .help("Don't unpack the swf file before deobfuscating.")
         .default_value(false)
         .implicit_value(true);
+    program.add_argument("--no-compact")
+        .help("Don't remove the duplicated and unused values from the constant pool.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--strip-dead-classes")
+        .help("Remove the static and wrapper classes once their uses have been unscrambled.")
+        .default_value(false)
+        .implicit_value(true);
     program.add_argument("-C", "--compression")
         .help(
             "Set the compression algorithm for the ouput file. Possible values: none, zlib, lzma.")
@@ -156,7 +131,31 @@ int main(int argc, char const* argv[]) {
         .help("Change the server's port to the given value. Implies --enable-proxy")
         .action([&enable_proxy](const auto& v) { enable_proxy = true; })
         .default_value(std::string("11801"));
-    program.add_argument("output").help("The ouput file.").required();
+    program.add_argument("--check-determinism")
+        .help("Deobfuscate the file twice, sequentially and using all the threads, and fail if "
+              "the outputs differ.")
+        .default_value(false)
+        .implicit_value(true);
+    program.add_argument("--serve")
+        .help("Stay resident and deobfuscate the files sent over the given Unix socket, instead of "
+              "a single file. See server.hpp for the protocol.");
+    program.add_argument("--serve-max-size")
+        .help("Biggest file accepted over the socket, in MiB.")
+        .default_value<uint32_t>(256)
+        .scan<'u', uint32_t>();
+    program.add_argument("--serve-requests")
+        .help("How many requests to process at once, the others wait. Each of them is kept in "
+              "memory.")
+        .default_value<uint32_t>(2)
+        .scan<'u', uint32_t>();
+    program.add_argument("--batch")
+        .help("Deobfuscate the files listed in the given manifest instead of a single file. Each "
+              "line holds an input and its output, separated by a tab or spaces.");
+    program.add_argument("--batch-files")
+        .help("How many files of the batch to process at once. Each of them is kept in memory.")
+        .default_value<uint32_t>(2)
+        .scan<'u', uint32_t>();
+    program.add_argument("output").help("The ouput file.").default_value(std::string(""));
 
     try {
         program.parse_args(argc, argv);
@@ -165,6 +164,29 @@ int main(int argc, char const* argv[]) {
         logger.log("{}", program.help().str());
         return 1;
     }
+    const bool serve = program.is_used("--serve");
+    const bool batch = program.is_used("--batch");
+    if (serve || batch) {
+        const auto mode = serve ? "--serve" : "--batch";
+        std::string conflict;
+        if (serve && batch)
+            conflict = "--batch";
+        else if (program.get<bool>("--check-determinism"))
+            conflict = "--check-determinism";
+        else if (program.is_used("-i"))
+            conflict = "-i";
+        else if (program.is_used("output"))
+            conflict = "an output file";
+
+        if (!conflict.empty()) {
+            logger.error("{} can't be used with {}.\n", mode, conflict);
+            return 1;
+        }
+    } else if (program.get("output").empty()) {
+        logger.error("The output file is required.\n");
+        logger.log("{}", program.help().str());
+        return 1;
+    }
 
     /* verbosity 0  -> warning
                  1  -> info
@@ -176,16 +198,36 @@ int main(int argc, char const* argv[]) {
     const auto output      = program.get("output");
     const auto config      = program.get("--config");
     const auto dump_config = program.get("--dump-config");
-    const auto compression = program.get("--compression");
     const auto jobs        = get_jobs(program.get<uint32_t>("--jobs"));
-    const bool is_url      = input.substr(0, 7) == "http://" || input.substr(0, 8) == "https://";
+
+    Options options;
+    options.unpack         = !program.get<bool>("--no-unpack");
+    options.compact        = !program.get<bool>("--no-compact");
+    options.strip_classes  = program.get<bool>("--strip-dead-classes");
+    options.ignore_missing = program.get<bool>("--ignore-missing");
+    options.enable_proxy   = enable_proxy;
+    options.proxy_port     = program.get("--proxy-port");
+    options.compression    = program.get("--compression");
+    options.schedule = program.get("--schedule") == "lpt" ? Schedule::lpt : Schedule::chunked;
+    if (program.present("--classdef"))
+        options.classdef = program.get("--classdef");
 
     utils::TimePoints tps = { { "start", utils::now() } };
-    std::unique_ptr<swf::StreamReader> stream;
-    std::unique_ptr<Unpacker> unp;
-    std::vector<uint8_t> buffer;
+
+    PacketDatabase packets;
+    if (program.present("--packets")) {
+        if (auto err = packets.load(program.get("--packets")); err) {
+            logger.error("{}\n", *err);
+            return 1;
+        }
+        options.packets = packets.tables();
+    }
 
     Fmt fmt;
+    if (jobs > 1)
+        logger.info("Spawning {} threads.\n", jobs);
+
+    ThreadPool pool(jobs);
 
     if (!config.empty()) {
         std::ifstream file(config);
@@ -197,179 +239,38 @@ int main(int argc, char const* argv[]) {
         file << Fmt::to_json().dump(4);
     }
 
-    auto action = fmt::format("{} file", is_url ? "Downloading" : "Reading");
-    logger.info("{} {}. ", action, input);
-    try {
-        if (is_url) {
-            unp = std::make_unique<Unpacker>(input);
-        } else if (input == "-") {
-            utils::read_from_stdin(buffer);
-            stream = std::make_unique<swf::StreamReader>(buffer);
-        } else {
-            stream = std::unique_ptr<swf::StreamReader>(swf::StreamReader::fromfile(input));
-        }
-    } catch (const std::runtime_error& err) {
-        logger.critical("Error: {}\n", err.what());
-        return 2;
+    Pipeline pipeline(options, fmt, pool, logger);
+    if (serve) {
+        const auto max_size     = size_t(program.get<uint32_t>("--serve-max-size")) << 20;
+        const auto max_requests = std::max<size_t>(program.get<uint32_t>("--serve-requests"), 1);
+        return Server(pipeline, options, logger, max_size, max_requests)
+            .serve(program.get("--serve"));
     }
-
-    const auto file_size = static_cast<double>(unp ? unp->size() : stream->size());
-    logger.log_done(tps, action);
-    logger.debug("File size: {}\n", utils::fmt_unit({ "B", "kB", "MB", "GB" }, file_size));
-
-    swf::Swf movie;
-    if (!program.get<bool>("--no-unpack")) {
-        if (unp == nullptr)
-            unp = std::make_unique<Unpacker>(std::move(stream));
-
-        logger.info("Unpacking. ");
-        if (!unp->unpack(movie, stream)) {
-            logger.log_done(tps, "Unpacking");
-            logger.error("Unable to unpack this swf. Is it already unpacked?\n");
-        } else {
-            logger.log_done(tps, "Unpacking");
+    if (batch) {
+        Batch batch(pipeline, logger);
+        if (auto err = batch.read(program.get("--batch")); err) {
+            logger.error("{}\n", *err);
+            return 1;
         }
+        return batch.run(program.get<uint32_t>("--batch-files"));
     }
-    if (movie.file_length == 0) {
-        logger.info("Parsing file. ");
-        movie.read(*stream);
-        logger.log_done(tps, "Parsing file");
-    }
-
-    auto frame1 = movie.abcfiles.find("frame1");
-    if (frame1 == movie.abcfiles.end()) {
-        logger.critical("Invalid SWF: Frame1 is not available.\n");
-        return 2;
-    } else {
-        logger.debug("Found frame1: {}\n", *frame1->second);
-        logger.info("Renaming invalid fields. ");
-    }
-
-    auto abc   = frame1->second->abcfile;
-    auto cpool = &abc->cpool;
-
-    // Rename the symbols to something more readable
-    // In fact it's the fully qualified name of a class,
-    // so we could rename the symbol using the class' name, but that's not really useful
-    uint32_t i = 0;
-    for (auto& it : movie.symbol_class->symbols) {
-        if (!Renamer::invalid(it.second))
-            continue;
-
-        auto pos  = it.second.find('_');
-        auto name = '$' + it.second.substr(pos + 1);
-        if (Renamer::invalid(name)) {
-            // Also rename invalid symbols
-            name = fmt.symbols.format(i++);
-        }
-        std::replace(cpool->strings.begin(), cpool->strings.end(), it.second, name);
-        it.second = name;
-    }
-
-    // Rename the first class as the Game class
-    // Rename the symbol too, so we can Go to document class
-    // Not using "Transformice" as the name, since this tool should work on other games too
-    // NOTE: FrameLabelTag should be renamed too
-    movie.symbol_class->symbols[0] = "Game";
-    abc->classes[0].rename("Game");
-
-    try {
-        Renamer renamer(abc, fmt);
-        renamer.rename();
-    } catch (const fmt::format_error& err) {
-        logger.error("Invalid format: {}", err.what());
-        return 2;
-    }
-
-    logger.log_done(tps, "Renaming invalid fields");
-    logger.info("Analyzing methods and classes. ");
-
-    detfm detfm(abc, fmt, logger);
-    detfm.simplify_init();
-    auto missing_classes = detfm.analyze();
-
-    logger.log_done(tps, "Analyzing methods and classes");
-    if (!missing_classes.empty()) {
-        logger.warn(
-            "{} could not be found:\n - {}\n",
-            (missing_classes.size() == 1 ? "This class" : "These classes"),
-            fmt::join(missing_classes, "\n - "));
-
-        if (!program.get<bool>("--ignore-missing")) {
-            logger.error("Use --ignore-missing to ignore this warning and continue.\n"
-                         "Continuing will most likely result in a crash.\n");
-            return 3;
-        }
-    }
-    logger.info("Unscrambling methods.\n");
-
-    unscramble(detfm, abc, jobs);
-
-    logger.log_done(tps, "Unscrambling methods");
-    logger.info("Renaming interesting stuff. ");
-    // add a newline when in debug, so logs from rename() are on a new line
-    logger.debug("\n");
-
-    detfm.rename();
-
-    logger.log_done(tps, "Renaming interesting stuff");
-    logger.info("Matching user-defined classes.\n");
-
-    if (program.present("--classdef")) {
-        std::list<std::shared_ptr<match::ClassMatcher>> classes;
-
-        for (const auto& entry : fs::directory_iterator(program.get("--classdef"))) {
-            if (entry.is_regular_file()) {
-                const auto& path = entry.path();
-                if (path.extension() == ".yml" || path.extension() == ".yaml")
-                    load_classdef(path.string(), classes);
-            }
-        }
 
-        for (auto& klass : classes) {
-            bool found = false;
-            for (uint32_t i = 0; i < abc->classes.size(); ++i) {
-                if (klass->match(abc, i) == match::MatchResult::match) {
-                    auto prev = abc->classes[i].get_name();
-                    klass->execute_actions();
-                    found = true;
-                    logger.info("Found class: {} -> {}\n", prev, abc->classes[i].get_name());
-                    break;
-                }
-            }
-
-            if (!found)
-                logger.error("Class not found.\n");
+    swf::Swf movie;
+    if (auto code = pipeline.load(input, movie, tps); code != 0)
+        return code;
 
-            // some debug shit
-            if (!klass->debug.empty()) {
-                for (uint32_t i = 0; i < abc->classes.size(); ++i) {
-                    if (abc->classes[i].get_name() == klass->debug) {
-                        klass->match(abc, i);
-                    }
-                }
-            }
-        }
+    swf::StreamWriter writer;
+    if (program.get<bool>("--check-determinism")) {
+        if (auto code = pipeline.check_determinism(movie, writer, tps); code != 0)
+            return code;
+        logger.info("Writing file. ");
     } else {
-        logger.info("Skipping, no path given.\n");
+        if (auto code = pipeline.run(movie, tps); code != 0)
+            return code;
+        logger.info("Writing file. ");
+        pipeline.write(movie, writer);
     }
 
-    logger.log_done(tps, "Matching user-defined classes");
-    if (enable_proxy) {
-        const auto port = program.get<std::string>("proxy-port");
-        logger.info("Proxying to {}. ", detfm.proxy2localhost(port));
-        logger.log_done(tps, "Proxying");
-    }
-    logger.info("Writing file. ");
-
-    // disable compression by default to speed up the write routine
-    movie.signature[0] = static_cast<uint8_t>(
-        compression == "none"
-            ? swf::Compression::None
-            : (compression == "zlib" ? swf::Compression::Zlib : swf::Compression::Lzma));
-
-    swf::StreamWriter writer;
-    movie.write(writer);
     if (output == "-") {
         if (std::ferror(std::freopen(nullptr, "wb", stdout))) {
             logger.error(std::strerror(errno));
@@ -0,0 +1,344 @@
+#include "pipeline.hpp"
+#include "detfm/ClassStripper.hpp"
+#include "detfm/PoolCompactor.hpp"
+#include "detfm/StringIndex.hpp"
+#include "detfm/printable.hpp"
+#include "fmt_swf.hpp"
+#include "match/ClassMatcher.hpp"
+#include "match/MatchResult.hpp"
+#include <abc/AbcFile.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <fmt/std.h>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+#include <unpacker.hpp>
+#include <utility>
+
+namespace athes::detfm {
+namespace fs = std::filesystem;
+using athes::unpack::Unpacker;
+
+// Loaded on first use, then reused by every run of the pipeline
+struct Pipeline::ClassDefs {
+    std::mutex mut;
+    bool loaded = false;
+    std::list<std::shared_ptr<match::ClassMatcher>> matchers;
+};
+
+Pipeline::Pipeline(Options options, Fmt fmt, ThreadPool& pool, utils::Logger logger)
+    : options(std::move(options)), fmt(std::move(fmt)), pool(pool), logger(logger),
+      classdefs(std::make_shared<ClassDefs>()) { }
+
+Pipeline Pipeline::with(Options options) const {
+    Pipeline pipeline(std::move(options), fmt, pool, logger);
+    pipeline.classdefs = classdefs;
+    return pipeline;
+}
+Pipeline Pipeline::with(utils::Logger logger) const {
+    Pipeline pipeline(options, fmt, pool, logger);
+    pipeline.classdefs = classdefs;
+    return pipeline;
+}
+
+int Pipeline::load(std::string const& input, swf::Swf& movie, utils::TimePoints& tps) {
+    const bool is_url = input.substr(0, 7) == "http://" || input.substr(0, 8) == "https://";
+    std::unique_ptr<swf::StreamReader> stream;
+    std::unique_ptr<Unpacker> unp;
+    std::vector<uint8_t> buffer;
+
+    auto action = fmt::format("{} file", is_url ? "Downloading" : "Reading");
+    logger.info("{} {}. ", action, input);
+    try {
+        if (is_url) {
+            unp = std::make_unique<Unpacker>(input);
+        } else if (input == "-") {
+            utils::read_from_stdin(buffer);
+            stream = std::make_unique<swf::StreamReader>(buffer);
+        } else {
+            stream = std::unique_ptr<swf::StreamReader>(swf::StreamReader::fromfile(input));
+        }
+    } catch (const std::runtime_error& err) {
+        logger.critical("Error: {}\n", err.what());
+        return 2;
+    }
+
+    const auto file_size = static_cast<double>(unp ? unp->size() : stream->size());
+    logger.log_done(tps, action);
+    logger.debug("File size: {}\n", utils::fmt_unit({ "B", "kB", "MB", "GB" }, file_size));
+    return parse(std::move(unp), std::move(stream), movie, tps);
+}
+
+int Pipeline::load(std::vector<uint8_t>& buffer, swf::Swf& movie, utils::TimePoints& tps) {
+    const auto file_size = static_cast<double>(buffer.size());
+    logger.debug("File size: {}\n", utils::fmt_unit({ "B", "kB", "MB", "GB" }, file_size));
+    return parse(nullptr, std::make_unique<swf::StreamReader>(buffer), movie, tps);
+}
+
+int Pipeline::parse(
+    std::unique_ptr<Unpacker> unp, std::unique_ptr<swf::StreamReader> stream, swf::Swf& movie,
+    utils::TimePoints& tps) {
+    if (options.unpack) {
+        if (unp == nullptr)
+            unp = std::make_unique<Unpacker>(std::move(stream));
+
+        logger.info("Unpacking. ");
+        if (!unp->unpack(movie, stream)) {
+            logger.log_done(tps, "Unpacking");
+            logger.error("Unable to unpack this swf. Is it already unpacked?\n");
+        } else {
+            logger.log_done(tps, "Unpacking");
+        }
+    }
+    if (movie.file_length == 0) {
+        logger.info("Parsing file. ");
+        movie.read(*stream);
+        logger.log_done(tps, "Parsing file");
+    }
+    return 0;
+}
+
+int Pipeline::run(swf::Swf& movie, utils::TimePoints& tps) {
+    auto frame1 = movie.abcfiles.find("frame1");
+    if (frame1 == movie.abcfiles.end()) {
+        logger.critical("Invalid SWF: Frame1 is not available.\n");
+        return 2;
+    } else {
+        logger.debug("Found frame1: {}\n", *frame1->second);
+        logger.info("Renaming invalid fields. ");
+    }
+
+    auto abc   = frame1->second->abcfile;
+    auto cpool = &abc->cpool;
+
+    // Rename the symbols to something more readable
+    // In fact it's the fully qualified name of a class,
+    // so we could rename the symbol using the class' name, but that's not really useful
+    uint32_t i = 0;
+    StringIndex strings(cpool->strings);
+    auto unprintable = unprintable_strings(cpool->strings);
+    for (auto& it : movie.symbol_class->symbols) {
+        const auto indices = strings.find(it.second);
+        if (indices.empty() ? !Renamer::invalid(it.second) : !unprintable[indices.front()])
+            continue;
+
+        auto pos  = it.second.find('_');
+        auto name = '$' + it.second.substr(pos + 1);
+        if (Renamer::invalid(name)) {
+            // Also rename invalid symbols
+            name = fmt.symbols.format(i++);
+        }
+        strings.replace(it.second, name);
+        for (auto index : indices)
+            unprintable[index] = Renamer::invalid(name);
+        it.second = name;
+    }
+
+    // Rename the first class as the Game class
+    // Rename the symbol too, so we can Go to document class
+    // Not using "Transformice" as the name, since this tool should work on other games too
+    // NOTE: FrameLabelTag should be renamed too
+    movie.symbol_class->symbols[0] = "Game";
+    abc->classes[0].rename("Game");
+    // The name is changed in place, it's valid now
+    const auto game = cpool->multinames[abc->classes[0].name].get_name_index();
+    if (game < unprintable.size())
+        unprintable[game] = 0;
+
+    try {
+        Renamer renamer(abc, fmt, std::move(unprintable));
+        renamer.rename(pool);
+    } catch (const fmt::format_error& err) {
+        logger.error("Invalid format: {}", err.what());
+        return 2;
+    }
+
+    logger.log_done(tps, "Renaming invalid fields");
+    logger.info("Analyzing methods and classes. ");
+
+    detfm detfm(abc, fmt, logger, pool);
+    detfm.packets = options.packets;
+    detfm.simplify_init();
+    auto missing_classes = detfm.analyze();
+
+    logger.log_done(tps, "Analyzing methods and classes");
+    if (!missing_classes.empty()) {
+        logger.warn(
+            "{} could not be found:\n - {}\n",
+            (missing_classes.size() == 1 ? "This class" : "These classes"),
+            fmt::join(missing_classes, "\n - "));
+
+        if (!options.ignore_missing) {
+            logger.error("Use --ignore-missing to ignore this warning and continue.\n"
+                         "Continuing will most likely result in a crash.\n");
+            return 3;
+        }
+    }
+    logger.info("Unscrambling methods.\n");
+
+    const auto balance = detfm.unscramble(options.schedule);
+    if (pool.size() > 1)
+        logger.debug(
+            "Load balance: {:.1f}% ({} threads)\n", balance.efficiency() * 100, balance.workers);
+    logger.debug("Skipped {} methods with nothing to unscramble\n", detfm.skipped_methods());
+
+    logger.log_done(tps, "Unscrambling methods");
+    logger.info("Renaming interesting stuff. ");
+    // add a newline when in debug, so logs from rename() are on a new line
+    logger.debug("\n");
+
+    detfm.rename();
+
+    logger.log_done(tps, "Renaming interesting stuff");
+    logger.info("Matching user-defined classes.\n");
+
+    if (options.classdef) {
+        // The matchers keep the state of their last match, so runs sharing them take turns
+        std::lock_guard<std::mutex> guard(classdefs->mut);
+        if (!classdefs->loaded) {
+            std::list<std::shared_ptr<match::ClassMatcher>> loaded;
+            for (const auto& entry : fs::directory_iterator(*options.classdef)) {
+                if (entry.is_regular_file()) {
+                    const auto& path = entry.path();
+                    if (path.extension() == ".yml" || path.extension() == ".yaml")
+                        load_classdef(path.string(), loaded);
+                }
+            }
+            classdefs->matchers = std::move(loaded);
+            classdefs->loaded   = true;
+        }
+
+        auto& classes = classdefs->matchers;
+
+        for (auto& klass : classes) {
+            bool found = false;
+            for (uint32_t i = 0; i < abc->classes.size(); ++i) {
+                if (klass->match(abc, i) == match::MatchResult::match) {
+                    auto prev = abc->classes[i].get_name();
+                    klass->execute_actions();
+                    found = true;
+                    logger.info("Found class: {} -> {}\n", prev, abc->classes[i].get_name());
+                    break;
+                }
+            }
+
+            if (!found)
+                logger.error("Class not found.\n");
+
+            // some debug shit
+            if (!klass->debug.empty()) {
+                for (uint32_t i = 0; i < abc->classes.size(); ++i) {
+                    if (abc->classes[i].get_name() == klass->debug) {
+                        klass->match(abc, i);
+                    }
+                }
+            }
+        }
+    } else {
+        logger.info("Skipping, no path given.\n");
+    }
+
+    logger.log_done(tps, "Matching user-defined classes");
+    if (options.enable_proxy) {
+        logger.info("Proxying to {}. ", detfm.proxy2localhost(options.proxy_port));
+        logger.log_done(tps, "Proxying");
+    }
+    if (options.strip_classes) {
+        logger.info("Removing dead classes. ");
+        const auto removed = ClassStripper(abc, pool).strip(detfm.dead_classes());
+        logger.log_done(tps, "Removing dead classes");
+        logger.debug(
+            "Removed {} classes, {} methods and {} scripts.\n",
+            removed.classes,
+            removed.methods,
+            removed.scripts);
+
+        // Symbols use the fully qualified name of the class, live classes may share a short one
+        auto& symbols = movie.symbol_class->symbols;
+        const std::unordered_set<std::string> names(removed.names.begin(), removed.names.end());
+        for (auto it = symbols.begin(); it != symbols.end();)
+            it = names.count(it->second) != 0 ? symbols.erase(it) : std::next(it);
+    }
+    if (options.compact) {
+        logger.info("Compacting the constant pool. ");
+        const auto removed = PoolCompactor(abc, pool).compact();
+        logger.log_done(tps, "Compacting the constant pool");
+        logger.debug(
+            "Removed {} integers, {} unsigned integers, {} doubles and {} strings.\n",
+            removed.integers,
+            removed.uintegers,
+            removed.doubles,
+            removed.strings);
+    }
+    return 0;
+}
+
+void Pipeline::write(swf::Swf& movie, swf::StreamWriter& writer) {
+    // disable compression by default to speed up the write routine
+    const auto& compression = options.compression;
+    movie.signature[0]      = static_cast<uint8_t>(
+        compression == "none"
+                 ? swf::Compression::None
+                 : (compression == "zlib" ? swf::Compression::Zlib : swf::Compression::Lzma));
+
+    movie.write(writer);
+}
+
+int Pipeline::check_determinism(
+    swf::Swf& movie, swf::StreamWriter& writer, utils::TimePoints& tps) {
+    // Both runs start from the same bytes
+    swf::StreamWriter snapshot;
+    movie.signature[0] = static_cast<uint8_t>(swf::Compression::None);
+    movie.write(snapshot);
+
+    ThreadPool sequential(1);
+    Pipeline reference(options, fmt, sequential, logger);
+    std::vector<uint8_t> expected;
+    {
+        std::vector<uint8_t> input(snapshot.get_buffer(), snapshot.get_buffer() + snapshot.size());
+        swf::StreamReader stream(input);
+        swf::Swf copy;
+        copy.read(stream);
+
+        logger.info("Deobfuscating sequentially.\n");
+        if (auto code = reference.run(copy, tps); code != 0)
+            return code;
+
+        swf::StreamWriter output;
+        reference.write(copy, output);
+        expected.assign(output.get_buffer(), output.get_buffer() + output.size());
+    }
+
+    std::vector<uint8_t> input(snapshot.get_buffer(), snapshot.get_buffer() + snapshot.size());
+    swf::StreamReader stream(input);
+    swf::Swf copy;
+    copy.read(stream);
+
+    logger.info("Deobfuscating using {} threads.\n", pool.size());
+    if (auto code = run(copy, tps); code != 0)
+        return code;
+
+    write(copy, writer);
+    const auto actual = writer.get_buffer();
+    const auto size   = std::min<size_t>(writer.size(), expected.size());
+    const auto offset = std::mismatch(expected.begin(), expected.begin() + size, actual).first
+        - expected.begin();
+
+    if (writer.size() != expected.size() || static_cast<size_t>(offset) != size) {
+        logger.error(
+            "Outputs differ at offset {} (sequential: {} bytes, parallel: {} bytes).\n",
+            offset,
+            expected.size(),
+            writer.size());
+        return 4;
+    }
+    logger.info("Outputs are identical ({} bytes).\n", expected.size());
+    return 0;
+}
+}
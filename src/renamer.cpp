@@ -1,12 +1,15 @@
 #include "renamer.hpp"
+#include "detfm/ThreadPool.hpp"
+#include "detfm/printable.hpp"
 #include <algorithm>
-#include <cctype>
 #include <fmt/compile.h>
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <iterator>
 #include <stdexcept>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace athes::detfm {
@@ -73,7 +76,7 @@ void Fmt::from_json(json& config, utils::Logger& logger) {
             std::replace(name.begin(), name.end(), '/', '.');
             logger.error("'{}' is not a valid format: {}\n", name.substr(1), *error);
         } else {
-            field->value = value;
+            field->set(value);
         }
     }
 }
@@ -106,74 +109,162 @@ Fmt::Fields Fmt::get_fields() {
     };
 }
 
-Renamer::Renamer(std::shared_ptr<abc::AbcFile> const& abc, Fmt const& fmt) : abc(abc), fmt(fmt) { }
+Renamer::Renamer(
+    std::shared_ptr<abc::AbcFile> const& abc, Fmt const& fmt, std::vector<uint8_t> unprintable)
+    : abc(abc), fmt(fmt), unprintable(std::move(unprintable)) {
+    if (this->unprintable.empty())
+        this->unprintable = unprintable_strings(abc->cpool.strings);
+}
 
 bool Renamer::invalid(std::string const& name) { return invalid(std::string_view(name)); }
-bool Renamer::invalid(std::string_view name) {
-    return std::any_of(
-        std::begin(name), std::end(name), [](const char c) { return !std::isprint(c); });
+bool Renamer::invalid(std::string_view name) { return !is_printable(name); }
+
+bool Renamer::name_index(uint32_t multiname, uint32_t& index) const {
+    if (multiname == 0 || multiname >= abc->cpool.multinames.size())
+        return false;
+
+    auto& mn = abc->cpool.multinames[multiname];
+    switch (mn.kind) {
+    case abc::MultinameKind::QName:
+    case abc::MultinameKind::QNameA:
+    case abc::MultinameKind::RTQName:
+    case abc::MultinameKind::RTQNameA:
+    case abc::MultinameKind::Multiname:
+    case abc::MultinameKind::MultinameA:
+        index = mn.get_name_index();
+        return index < unprintable.size();
+    default:
+        return false;
+    }
+}
+template <typename Name> bool Renamer::invalid(uint32_t multiname, Name const& name) {
+    uint32_t index;
+    return name_index(multiname, index) ? unprintable[index] != 0 : invalid(name());
+}
+void Renamer::validated(uint32_t multiname) {
+    // Renaming changes the multiname's string in place, for every other name using it
+    uint32_t index;
+    if (name_index(multiname, index))
+        unprintable[index] = 0;
 }
 
-void Renamer::rename() {
-    for (auto& klass : abc->classes)
-        rename(klass);
+void Renamer::rename(ThreadPool& pool) {
+    auto& classes = abc->classes;
+    auto& methods = abc->methods;
+
+    // Names that are invalid before anything is renamed, per class then per method
+    std::vector<std::vector<Pending>> found(classes.size() + methods.size());
+    pool.parallel_for(found.size(), [&](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i) {
+            if (i < classes.size())
+                find_invalid(classes[i], found[i]);
+            else
+                find_invalid(methods[i - classes.size()], found[i]);
+        }
+    });
+
+    // Number the names in the sequential order. Renaming changes the shared string in place, which
+    // makes it valid for the next names using it: only its first use is renamed.
+    std::vector<Pending*> renames;
+    std::vector<uint8_t> renamed(unprintable.size(), 0);
+    std::unordered_set<uint32_t> renamed_multinames;
+    for (auto& pendings : found) {
+        for (auto& pending : pendings) {
+            uint32_t index;
+            const bool first = name_index(pending.multiname, index)
+                ? !std::exchange(renamed[index], 1)
+                : renamed_multinames.insert(pending.multiname).second;
+            if (!first)
+                continue;
+
+            if (auto counter = numbering(pending).first)
+                pending.counter = ++*counter;
+            renames.push_back(&pending);
+        }
+    }
 
-    for (auto& method : abc->methods)
-        rename(method);
+    // Format the names in parallel, the constant pool is only changed by this thread
+    pool.parallel_for(renames.size(), [&](WorkRange range) {
+        for (auto i = range.first; i < range.last; ++i)
+            renames[i]->name = new_name(*renames[i]);
+    });
+    for (auto pending : renames)
+        apply(*pending);
 }
 
-void Renamer::rename(abc::Class& klass) {
-    if (klass.name != 0 && invalid(klass.get_name()))
-        klass.rename(fmt.classes.format(++counters.classes));
+void Renamer::find_invalid(abc::Class& klass, std::vector<Pending>& found) {
+    using Target = Pending::Target;
+    if (klass.name != 0 && invalid(klass.name, [&klass] { return klass.get_name(); }))
+        found.push_back({ Target::klass, &klass, klass.name });
 
-    if (klass.super_name != 0 && invalid(klass.get_super_name()))
-        klass.rename_super(fmt.classes.format(++counters.classes));
+    if (klass.super_name != 0
+        && invalid(klass.super_name, [&klass] { return klass.get_super_name(); }))
+        found.push_back({ Target::super, &klass, klass.super_name });
 
     for (auto& trait : klass.ctraits)
-        rename(trait);
+        find_invalid(trait, found);
 
     for (auto& trait : klass.itraits)
-        rename(trait);
+        find_invalid(trait, found);
 }
-void Renamer::rename(abc::Trait& trait) {
-    if (trait.name != 0 && invalid(trait.get_name())) {
-        switch (trait.kind) {
+void Renamer::find_invalid(abc::Trait& trait, std::vector<Pending>& found) {
+    if (trait.name != 0 && invalid(trait.name, [&trait] { return trait.get_name(); }))
+        found.push_back({ Pending::Target::trait, &trait, trait.name });
+}
+void Renamer::find_invalid(abc::Method& method, std::vector<Pending>& found) {
+    // A single exception is named "error", several are numbered
+    int counter = 0;
+    for (auto& err : method.exceptions) {
+        counter += method.exceptions.size() != 1;
+        if (invalid(err.var_name, [&err] { return err.get_var_name(); }))
+            found.push_back({ Pending::Target::error, &err, err.var_name, counter });
+    }
+
+    for (auto& trait : method.traits)
+        find_invalid(trait, found);
+}
+
+std::pair<int*, StringFmt<uint32_t>*> Renamer::numbering(Pending const& pending) {
+    switch (pending.target) {
+    case Pending::Target::klass:
+    case Pending::Target::super:
+        return { &counters.classes, &fmt.classes };
+    case Pending::Target::trait:
+        switch (static_cast<abc::Trait*>(pending.object)->kind) {
         case abc::TraitKind::Const:
-            trait.rename(fmt.consts.format(++counters.consts));
-            break;
+            return { &counters.consts, &fmt.consts };
         case abc::TraitKind::Method:
-            trait.rename(fmt.methods.format(++counters.methods));
-            break;
+            return { &counters.methods, &fmt.methods };
         case abc::TraitKind::Function:
-            trait.rename(fmt.functions.format(++counters.functions));
-            break;
+            return { &counters.functions, &fmt.functions };
         default:
-            trait.rename(fmt.names.format(++counters.names));
-            break;
+            return { &counters.names, &fmt.names };
         }
+    default:
+        return { nullptr, nullptr };
     }
 }
+std::string Renamer::new_name(Pending const& pending) {
+    if (pending.target == Pending::Target::error)
+        return pending.counter == 0 ? "error" : fmt.errors.format(pending.counter);
 
-void Renamer::rename(abc::Method& method) {
-    int counter = 0;
-    if (method.exceptions.size() == 1) {
-        rename(method.exceptions[0]);
-    } else {
-        for (auto& err : method.exceptions)
-            rename(err, ++counter);
-    }
-
-    for (auto& trait : method.traits)
-        rename(trait);
-}
-void Renamer::rename(abc::Exception& err) {
-    if (invalid(err.get_var_name()))
-        err.rename_var_name("error");
+    return numbering(pending).second->format(pending.counter);
 }
-void Renamer::rename(abc::Exception& err, int counter) {
-    if (invalid(err.get_var_name())) {
-        auto name = fmt.errors.format(counter);
-        err.rename_var_name(name);
+void Renamer::apply(Pending& pending) {
+    switch (pending.target) {
+    case Pending::Target::klass:
+        static_cast<abc::Class*>(pending.object)->rename(std::move(pending.name));
+        break;
+    case Pending::Target::super:
+        static_cast<abc::Class*>(pending.object)->rename_super(std::move(pending.name));
+        break;
+    case Pending::Target::trait:
+        static_cast<abc::Trait*>(pending.object)->rename(std::move(pending.name));
+        break;
+    case Pending::Target::error:
+        static_cast<abc::Exception*>(pending.object)->rename_var_name(std::move(pending.name));
+        break;
     }
+    validated(pending.multiname);
 }
 }
\ No newline at end of file
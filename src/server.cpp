@@ -0,0 +1,290 @@
+#include "server.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <exception>
+#include <fmt/format.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace athes::detfm {
+// Longest accepted request line, the movie's bytes are sent separately
+constexpr size_t max_line = 64 * 1024;
+
+/* Buffered reads and full writes on a connected socket, closed on destruction */
+class Connection {
+public:
+    Connection(int fd) : fd(fd) { }
+    ~Connection() { close(fd); }
+
+    Connection(Connection const&)            = delete;
+    Connection& operator=(Connection const&) = delete;
+
+    /* Read up to the next newline, excluded. Return false upon EOF, error or too long a line */
+    bool read_line(std::string& line) {
+        line.clear();
+        while (true) {
+            auto it = std::find(pending.begin(), pending.end(), '\n');
+            line.append(pending.begin(), it);
+            if (it != pending.end()) {
+                pending.erase(pending.begin(), it + 1);
+                return true;
+            }
+
+            pending.clear();
+            if (line.size() > max_line || !fill())
+                return false;
+        }
+    }
+    /* Read exactly size bytes */
+    bool read(std::vector<uint8_t>& data, size_t size) {
+        // Grows as the bytes arrive: the size comes from the client
+        data.clear();
+        while (true) {
+            const auto count = std::min(size - data.size(), pending.size());
+            data.insert(data.end(), pending.begin(), pending.begin() + count);
+            pending.erase(pending.begin(), pending.begin() + count);
+            if (data.size() == size)
+                return true;
+            if (!fill())
+                return false;
+        }
+    }
+    bool write(void const* data, size_t size) {
+        auto ptr = static_cast<char const*>(data);
+        while (size > 0) {
+            const auto sent = send(fd, ptr, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+
+            ptr += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+    bool reply(json const& response) {
+        const auto line = response.dump() + '\n';
+        return write(line.data(), line.size());
+    }
+
+private:
+    int fd;
+    std::vector<char> pending;
+
+    bool fill() {
+        std::array<char, 64 * 1024> buf;
+        while (true) {
+            const auto length = recv(fd, buf.data(), buf.size(), 0);
+            if (length < 0 && errno == EINTR)
+                continue;
+            if (length <= 0)
+                return false;
+
+            pending.insert(pending.end(), buf.data(), buf.data() + length);
+            return true;
+        }
+    }
+};
+
+/* Apply the options given by the request. Return the error message for invalid ones */
+static std::optional<std::string> override_options(json const& request, Options& options) {
+    options.unpack         = request.value("unpack", options.unpack);
+    options.compact        = request.value("compact", options.compact);
+    options.strip_classes  = request.value("strip_dead_classes", options.strip_classes);
+    options.ignore_missing = request.value("ignore_missing", options.ignore_missing);
+    options.compression    = request.value("compression", options.compression);
+    if (request.contains("proxy_port")) {
+        options.enable_proxy = true;
+        options.proxy_port   = request["proxy_port"].get<std::string>();
+    }
+    if (request.contains("schedule")) {
+        const auto schedule = request["schedule"].get<std::string>();
+        if (schedule != "lpt" && schedule != "chunked")
+            return fmt::format("Invalid scheduling mode: {}", schedule);
+
+        options.schedule = schedule == "lpt" ? Schedule::lpt : Schedule::chunked;
+    }
+
+    const auto& compression = options.compression;
+    if (compression != "none" && compression != "zlib" && compression != "lzma")
+        return fmt::format("Invalid compression algorithm: {}", compression);
+
+    return std::nullopt;
+}
+
+Server::Server(
+    Pipeline& pipeline, Options options, utils::Logger logger, size_t max_size,
+    size_t max_requests)
+    : pipeline(pipeline), options(std::move(options)), logger(logger), max_size(max_size),
+      max_requests(max_requests) { }
+
+int Server::serve(std::string const& path) {
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        logger.error("The socket path is too long: {}\n", path);
+        return 1;
+    }
+    std::copy(path.begin(), path.end(), addr.sun_path);
+
+    // A previous instance may have left its socket behind
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || listen(server, SOMAXCONN) != 0) {
+        logger.error("Unable to listen on {}: {}\n", path, std::strerror(errno));
+        if (server >= 0)
+            close(server);
+        return 2;
+    }
+
+    logger.log("Listening on {}.\n", path);
+    while (true) {
+        const int fd = accept(server, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            logger.error("Unable to accept a connection: {}\n", std::strerror(errno));
+            close(server);
+            reap(true);
+            return 2;
+        }
+
+        reap(false);
+        std::lock_guard lock(mutex);
+        auto& worker  = workers.emplace_back();
+        worker.fd     = fd;
+        worker.thread = std::thread(&Server::handle, this, std::ref(worker));
+    }
+}
+
+void Server::reap(bool all) {
+    std::list<Worker> done;
+    {
+        std::lock_guard lock(mutex);
+        for (auto it = workers.begin(); it != workers.end();) {
+            auto worker = it++;
+            // Wakes the threads up from their reads, their current request is still answered
+            if (all && worker->fd >= 0)
+                shutdown(worker->fd, SHUT_RDWR);
+            if (all || worker->fd < 0)
+                done.splice(done.end(), workers, worker);
+        }
+    }
+    for (auto& worker : done)
+        worker.thread.join();
+}
+
+void Server::handle(Worker& worker) {
+    Connection conn(worker.fd);
+    std::string line;
+    try {
+        while (conn.read_line(line))
+            if (!respond(conn, line))
+                break;
+    } catch (const std::exception& err) {
+        // Only drop this connection, the others are still being served
+        logger.error("Connection closed: {}\n", err.what());
+    }
+
+    // Forgotten before conn closes it, serve() must never shut a reused descriptor down
+    std::lock_guard lock(mutex);
+    worker.fd = -1;
+}
+
+bool Server::respond(Connection& conn, std::string const& line) {
+    const auto request = json::parse(line, nullptr, false);
+    if (request.is_discarded() || !request.is_object())
+        return conn.reply({ { "status", 1 }, { "error", "The request must be a JSON object" } });
+
+    // Wait for a slot before reading the movie: the waiting requests aren't kept in memory
+    struct Slot {
+        Server& server;
+        ~Slot() {
+            std::lock_guard lock(server.mutex);
+            --server.requests;
+            server.released.notify_one();
+        }
+    };
+    std::unique_lock lock(mutex);
+    released.wait(lock, [this] { return requests < max_requests; });
+    ++requests;
+    lock.unlock();
+    Slot slot { *this };
+
+    // Consume the movie before validating anything else, so the connection stays usable after
+    // an invalid request. Without a valid size, the bytes that follow can't be skipped.
+    std::vector<uint8_t> buffer;
+    if (request.contains("size")) {
+        auto& size = request["size"];
+        if (!size.is_number_unsigned()) {
+            conn.reply({ { "status", 1 }, { "error", "The size must be a positive integer" } });
+            return false;
+        }
+        if (size.get<uint64_t>() > max_size) {
+            conn.reply({ { "status", 1 }, { "error", "The movie is too big" } });
+            return false;
+        }
+        if (!conn.read(buffer, size.get<size_t>()))
+            return false;
+    }
+
+    Options opts = options;
+    std::string input;
+    try {
+        if (auto err = override_options(request, opts); err)
+            return conn.reply({ { "status", 1 }, { "error", *err } });
+
+        input = request.value("input", std::string());
+    } catch (const json::exception& err) {
+        return conn.reply({ { "status", 1 }, { "error", err.what() } });
+    }
+    if (!request.contains("size") && (input.empty() || input == "-"))
+        return conn.reply({ { "status", 1 }, { "error", "Expected an input or a size" } });
+
+    // The progress messages are written piece by piece, those of concurrent requests would be
+    // mixed: only a line per request is logged
+    auto quiet  = logger;
+    quiet.level = std::max(quiet.level, utils::LogLevel::WARNING);
+
+    const auto source = request.contains("size") ? fmt::format("{} bytes", buffer.size()) : input;
+
+    utils::TimePoints tps = { { "start", utils::now() } };
+    auto runner           = pipeline.with(std::move(opts)).with(quiet);
+    swf::Swf movie;
+    swf::StreamWriter writer;
+    try {
+        int code = request.contains("size") ? runner.load(buffer, movie, tps)
+                                            : runner.load(input, movie, tps);
+        if (code == 0)
+            code = runner.run(movie, tps);
+        if (code != 0) {
+            logger.error("{}: failed with exit code {}.\n", source, code);
+            return conn.reply({ { "status", code } });
+        }
+
+        runner.write(movie, writer);
+    } catch (const std::exception& err) {
+        logger.error("{}: {}\n", source, err.what());
+        return conn.reply({ { "status", 2 }, { "error", err.what() } });
+    }
+
+    const auto took = utils::elapsled(tps.front().second, utils::now());
+    logger.info("{}: done ({}).\n", source, utils::fmt_unit({ "µs", "ms", "s" }, took, 1000));
+    return conn.reply({ { "status", 0 }, { "size", writer.size() } })
+        && conn.write(writer.get_buffer(), writer.size());
+}
+}
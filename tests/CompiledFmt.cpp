@@ -0,0 +1,78 @@
+#include "detfm/CompiledFmt.hpp"
+#include "renamer.hpp"
+#include <cstdint>
+#include <fmt/format.h>
+#include <limits>
+#include <string>
+#include <string_view>
+
+using namespace athes::detfm;
+
+// CompiledFmt must give the same output as fmt for every format detfm may use
+static int failures = 0;
+
+template <typename... Types>
+static void check(std::string_view format, CompiledFmt const& compiled, Types const&... args) {
+    const auto expected = fmt::vformat(format, fmt::make_format_args(args...));
+    const auto got      = compiled.format(args...);
+    if (got != expected) {
+        fmt::print("\"{}\": expected \"{}\", got \"{}\"\n", format, expected, got);
+        ++failures;
+    }
+}
+template <typename... Types> static void check(std::string_view format, Types const&... args) {
+    check(format, CompiledFmt(format), args...);
+}
+template <typename... Types>
+static void check(StringFmt<Types...> const& field, Types const&... args) {
+    check(field.value, field.compiled, args...);
+}
+
+int main() {
+    const Fmt fmt;
+    for (uint32_t value : { 0u, 7u, 42u, 999u, 1000u, 123456u, 0xffffffffu }) {
+        check(fmt.classes, value);
+        check(fmt.consts, value);
+        check(fmt.functions, value);
+        check(fmt.names, value);
+        check(fmt.vars, value);
+        check(fmt.methods, value);
+        check(fmt.errors, value);
+        check(fmt.symbols, value);
+    }
+    for (uint16_t value : { 0, 7, 0x1c, 99, 100, 0x1234, 0xffff }) {
+        check(fmt.packet_subhandler, value);
+        check(fmt.unknown_clientbound_packet, value);
+        check(fmt.tribulle_clientbound_packet, value, std::string_view("_Name"));
+        check(fmt.tribulle_serverbound_packet, value, std::string_view());
+    }
+    for (uint8_t code : { 0, 1, 0x1c, 0xff }) {
+        check(fmt.clientbound_packet, code, uint8_t(5), std::string_view("_Name"));
+        check(fmt.serverbound_packet, uint8_t(0xa0), code, std::string_view());
+    }
+
+    const auto min = std::numeric_limits<int32_t>::min();
+    for (int32_t value : { 0, 5, -5, 26, -26, 42, -42, 0xabcde, min }) {
+        check("{:0>4x}", value);
+        check("{:05d}", value);
+        check("{:5}", value);
+        check("{:<5d}", value);
+        check("{:#x}", value);
+        check("{:X}", value);
+        check("{}", value);
+    }
+    check("{:05d}", std::numeric_limits<int64_t>::min());
+    check("{:05d}", std::numeric_limits<int64_t>::max());
+    check("{:5}", std::string_view("ab"));
+    check("{:5}", std::string("ab"));
+    check("{}", std::string_view("ab"));
+    check("{:5}", true);
+    check("{{}}");
+    check("{{{}}}", 1);
+    check("{0}_{0}", 12);
+    check("{1}{0:03d}", 7, std::string_view("name_"));
+
+    if (failures != 0)
+        fmt::print("{} formats differ from fmt\n", failures);
+    return failures != 0;
+}